@@ -0,0 +1,97 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALIBenchmark.h"
+
+static const uint8_t bench_gear[] = {1, 8, 16, 32, 63};
+// Input devices and instances per device
+static const uint8_t bench_inputs[][2] = {{0, 0}, {4, 2}, {16, 4}};
+static const SimRandomMode bench_modes[] = {
+    SIM_RANDOM_UNIFORM, SIM_RANDOM_CLUSTERED, SIM_RANDOM_ADJACENT,
+    SIM_RANDOM_DUPLICATES};
+static const char *const bench_mode_names[] = {"uniform", "clustered",
+                                               "adjacent", "duplicates"};
+
+static void copy_cost(commissioning_cost &cost, const dali_api_stats &api)
+{
+    cost.forward_frames = api.frames;
+    cost.backward_frames = api.answers;
+    cost.sim_us = (uint32_t)api.total_us;
+}
+
+void run_commissioning_case(DALIDriver &dali, DALISimBus &sim,
+                            const commissioning_case &config,
+                            commissioning_result &result)
+{
+    // Too large for most thread stacks
+    static dali_stats stats;
+
+    sim.reset(config.num_gear, config.num_inputs, config.instances,
+              config.mode);
+    dali.encoder.set_bus_model(&sim);
+    dali.reset_stats();
+    dali.init();
+    dali.get_stats(stats);
+    dali.encoder.set_bus_model(NULL);
+
+    result.config = config;
+    result.lights_found = dali.get_num_lights();
+    result.inputs_found = dali.get_num_inputs();
+    copy_cost(result.init, stats.api[API_INIT]);
+    copy_cost(result.init_lights, stats.api[API_INIT_LIGHTS]);
+    copy_cost(result.init_inputs, stats.api[API_INIT_INPUTS]);
+    copy_cost(result.assign_addresses, stats.api[API_ASSIGN_ADDRESSES]);
+    copy_cost(result.assign_addresses_input,
+              stats.api[API_ASSIGN_ADDRESSES_INPUT]);
+}
+
+int run_commissioning_benchmark(
+    DALIDriver &dali, DALISimBus &sim,
+    mbed::Callback<void(const commissioning_result &)> report)
+{
+    int runs = 0;
+    commissioning_result result;
+    for (size_t g = 0; g < sizeof(bench_gear); g++) {
+        for (size_t i = 0; i < sizeof(bench_inputs) / 2; i++) {
+            for (size_t m = 0; m < sizeof(bench_modes) / sizeof(bench_modes[0]);
+                 m++) {
+                commissioning_case config;
+                config.num_gear = bench_gear[g];
+                config.num_inputs = bench_inputs[i][0];
+                config.instances = bench_inputs[i][1];
+                config.mode = bench_modes[m];
+                run_commissioning_case(dali, sim, config, result);
+                report(result);
+                runs++;
+            }
+        }
+    }
+    return runs;
+}
+
+void print_commissioning_result(const commissioning_result &r)
+{
+    printf("gear %2d inputs %2d x%d %-10s found %2d/%2d | init %5lu fwd %5lu "
+           "bwd %7.2f s | lights %5lu fwd %6.2f s | inputs %5lu fwd %6.2f s\r\n",
+           r.config.num_gear, r.config.num_inputs, r.config.instances,
+           bench_mode_names[r.config.mode], r.lights_found, r.inputs_found,
+           (unsigned long)r.init.forward_frames,
+           (unsigned long)r.init.backward_frames, r.init.sim_us / 1e6f,
+           (unsigned long)r.init_lights.forward_frames,
+           r.init_lights.sim_us / 1e6f,
+           (unsigned long)r.init_inputs.forward_frames,
+           r.init_inputs.sim_us / 1e6f);
+}
@@ -0,0 +1,78 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_BENCHMARK_H
+#define DALI_BENCHMARK_H
+
+#include "DALIDriver.h"
+#include "DALISimBus.h"
+
+// A simulated bus to commission
+struct commissioning_case {
+    uint8_t num_gear;
+    uint8_t num_inputs;
+    uint8_t instances;
+    SimRandomMode mode;
+};
+
+// Bus cost of one driver call
+struct commissioning_cost {
+    uint32_t forward_frames;
+    uint32_t backward_frames;
+    uint32_t sim_us;
+};
+
+struct commissioning_result {
+    commissioning_case config;
+    // Devices the driver addressed, fewer than configured means some were lost
+    int lights_found;
+    int inputs_found;
+    commissioning_cost init;
+    commissioning_cost init_lights;
+    commissioning_cost init_inputs;
+    commissioning_cost assign_addresses;
+    commissioning_cost assign_addresses_input;
+};
+
+/** Commission simulated buses of 1 to 63 gear, with and without input
+ * devices, for each random address distribution
+ *
+ *   @param dali     Driver to benchmark, its bus is replaced by sim while the
+ * benchmark runs
+ *   @param sim      Simulated bus to use
+ *   @param report   Called with the result of each case
+ *   @returns        Number of cases run
+ */
+int run_commissioning_benchmark(
+    DALIDriver &dali, DALISimBus &sim,
+    mbed::Callback<void(const commissioning_result &)> report);
+
+/** Commission one simulated bus with DALIDriver::init
+ *
+ *   @param dali     Driver to benchmark, its bus is replaced by sim
+ *   @param sim      Simulated bus to use
+ *   @param config   Devices on the bus
+ *   @param result   Filled with the cost of the calls
+ */
+void run_commissioning_case(DALIDriver &dali, DALISimBus &sim,
+                            const commissioning_case &config,
+                            commissioning_result &result);
+
+/** Print a result as one line of a table
+ */
+void print_commissioning_result(const commissioning_result &result);
+
+#endif
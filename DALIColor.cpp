@@ -0,0 +1,295 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALIColor.h"
+
+// 2^32 / d at 65 points d = 2^15 + 2^9 * i spanning [2^15, 2^16]
+static const uint32_t recip_table[65] = {
+    131072, 129056, 127100, 125203, 123362, 121574,
+    119837, 118149, 116508, 114912, 113360, 111848,
+    110376, 108943, 107546, 106185, 104858, 103563,
+    102300, 101068, 99864, 98690, 97542, 96421,
+    95325, 94254, 93207, 92183, 91181, 90200,
+    89241, 88301, 87381, 86480, 85598, 84733,
+    83886, 83056, 82241, 81443, 80660, 79892,
+    79138, 78398, 77672, 76960, 76260, 75573,
+    74898, 74235, 73584, 72944, 72316, 71698,
+    71090, 70493, 69905, 69327, 68759, 68200,
+    67650, 67109, 66576, 66052, 65536
+};
+
+// Points of the Planckian locus every 16 mirek from COLOR_MIREK_MIN
+#define LOCUS_STEP 16
+#define LOCUS_POINTS 37
+static const dali_xy locus[LOCUS_POINTS] = {
+    {16546, 16532}, {16969, 17104}, {17447, 17726}, {17972, 18385},
+    {18542, 19066}, {19151, 19759}, {19794, 20451}, {20466, 21134},
+    {21163, 21798}, {21879, 22436}, {22609, 23042}, {23350, 23611},
+    {24095, 24141}, {24841, 24628}, {25585, 25082}, {26309, 25483},
+    {27019, 25837}, {27712, 26145}, {28390, 26409}, {29050, 26632},
+    {29694, 26815}, {30320, 26960}, {30928, 27070}, {31518, 27148},
+    {32089, 27196}, {32641, 27215}, {33173, 27210}, {33685, 27183},
+    {34176, 27133}, {34647, 27065}, {35096, 26980}, {35523, 26882},
+    {35929, 26772}, {36311, 26654}, {36671, 26530}, {37007, 26403},
+    {37319, 26275}
+};
+
+// D65 white point
+static const dali_xy white_d65 = {20493, 21561};
+
+uint32_t color_div(uint32_t n, uint16_t d)
+{
+    return (n + (d >> 1)) / d;
+}
+
+// 1000000 / d rounded to nearest without a divide, d >= 16
+static uint16_t color_million_div(uint16_t d)
+{
+    // Normalise d to [2^15, 2^16)
+    int shift = 0;
+    uint32_t dn = d;
+    if (dn < 0x100) {
+        dn <<= 8;
+        shift += 8;
+    }
+    if (dn < 0x1000) {
+        dn <<= 4;
+        shift += 4;
+    }
+    if (dn < 0x4000) {
+        dn <<= 2;
+        shift += 2;
+    }
+    if (dn < 0x8000) {
+        dn <<= 1;
+        shift += 1;
+    }
+    // 2^32 / dn interpolated between the closest table points
+    uint32_t i = (dn >> 9) - 64;
+    uint32_t frac = dn & 0x1FF;
+    uint32_t r = recip_table[i] -
+                 (((recip_table[i] - recip_table[i + 1]) * frac) >> 9);
+    // 1000000 = 15625 << 6, and 15625 * r fits in 32 bits
+    uint32_t q = (15625 * r) >> (26 - shift);
+    // q is at most one off for every d >= 16, fix it against the rounded
+    // dividend
+    int32_t e = (int32_t)(1000000 + (d >> 1)) - (int32_t)(q * d);
+    if (e < 0) {
+        q--;
+    } else if (e >= d) {
+        q++;
+    }
+    return q;
+}
+
+uint16_t color_kelvin_to_mirek(uint16_t kelvin)
+{
+    if (kelvin < 16) {
+        return 0xFFFE;
+    }
+    return color_million_div(kelvin);
+}
+
+uint16_t color_mirek_to_kelvin(uint16_t mirek)
+{
+    if (mirek < 16) {
+        return 0xFFFF;
+    }
+    return color_million_div(mirek);
+}
+
+uint16_t color_clamp_mirek(uint16_t mirek, uint16_t coolest,
+                           uint16_t warmest)
+{
+    if (mirek < coolest) {
+        return coolest;
+    }
+    if (mirek > warmest) {
+        return warmest;
+    }
+    return mirek;
+}
+
+// Shift a ratio down until its divisor fits in 16 bits
+static uint32_t color_ratio(uint32_t n, uint32_t d, int scale)
+{
+    while (d > 0xFFFF) {
+        n >>= 1;
+        d >>= 1;
+    }
+    uint32_t q = color_div(n << scale, d);
+    return q > 0xFFFF ? 0xFFFF : q;
+}
+
+dali_xy color_rgb_to_xy(uint8_t r, uint8_t g, uint8_t b)
+{
+    // sRGB to XYZ in 1/4096
+    uint32_t X = 1689 * r + 1465 * g + 739 * b;
+    uint32_t Y = 871 * r + 2929 * g + 296 * b;
+    uint32_t Z = 79 * r + 488 * g + 3893 * b;
+    uint32_t sum = X + Y + Z;
+    if (sum == 0) {
+        return white_d65;
+    }
+    // Keep n << 16 in 32 bits
+    while (sum > 0xFFFF) {
+        X >>= 1;
+        Y >>= 1;
+        sum >>= 1;
+    }
+    dali_xy xy;
+    xy.x = color_ratio(X, sum, 16);
+    xy.y = color_ratio(Y, sum, 16);
+    return xy;
+}
+
+dali_rgb color_xy_to_rgb(dali_xy xy)
+{
+    dali_rgb rgb = {0, 0, 0, 0};
+    if (xy.y == 0 || (uint32_t)xy.x + xy.y > 0xFFFF) {
+        return rgb;
+    }
+    // XYZ in 1/4096 with Y = 1
+    int32_t X = color_div((uint32_t)xy.x << 12, xy.y);
+    int32_t Y = 4096;
+    int32_t Z = color_div((0x10000 - xy.x - xy.y) << 12, xy.y);
+    // XYZ to sRGB, back to 1/4096. X and Z grow like 1/y, near the violet
+    // end of the locus the products need 64 bits
+    int64_t c[3];
+    c[0] = ((int64_t)13273 * X - 6296 * Y - (int64_t)2042 * Z) >> 12;
+    c[1] = ((int64_t)-3969 * X + 7683 * Y + (int64_t)170 * Z) >> 12;
+    c[2] = ((int64_t)228 * X - 836 * Y + (int64_t)4329 * Z) >> 12;
+    int64_t max = 0;
+    for (int i = 0; i < 3; i++) {
+        // Outside the gamut
+        if (c[i] < 0) {
+            c[i] = 0;
+        }
+        if (c[i] > max) {
+            max = c[i];
+        }
+    }
+    if (max == 0) {
+        return rgb;
+    }
+    // Only the ratios matter, keep c * 254 in 32 bits
+    while (max > 0xFFFF) {
+        for (int i = 0; i < 3; i++) {
+            c[i] >>= 1;
+        }
+        max >>= 1;
+    }
+    rgb.r = color_ratio(c[0] * 254, max, 0);
+    rgb.g = color_ratio(c[1] * 254, max, 0);
+    rgb.b = color_ratio(c[2] * 254, max, 0);
+    return rgb;
+}
+
+// n / d in 1/65536 for n < d, saturated otherwise
+static uint16_t color_fraction(uint32_t n, uint32_t d)
+{
+    if (n >= d) {
+        return 0xFFFF;
+    }
+    return color_ratio(n, d, 16);
+}
+
+dali_uv color_xy_to_uv(dali_xy xy)
+{
+    // u' = 4x / (12y - 2x + 3), v' = 9y / (12y - 2x + 3)
+    uint32_t d = 12 * (uint32_t)xy.y - 2 * (uint32_t)xy.x + 3 * 0x10000;
+    dali_uv uv;
+    uv.u = color_fraction(4 * (uint32_t)xy.x, d);
+    uv.v = color_fraction(9 * (uint32_t)xy.y, d);
+    return uv;
+}
+
+dali_xy color_uv_to_xy(dali_uv uv)
+{
+    // x = 9u' / (6u' - 16v' + 12), y = 4v' / (6u' - 16v' + 12)
+    int32_t d = 6 * (int32_t)uv.u - 16 * (int32_t)uv.v + 12 * 0x10000;
+    dali_xy xy = {0, 0};
+    if (d <= 0) {
+        return xy;
+    }
+    xy.x = color_fraction(9 * (uint32_t)uv.u, d);
+    xy.y = color_fraction(4 * (uint32_t)uv.v, d);
+    return xy;
+}
+
+dali_xy color_mirek_to_xy(uint16_t mirek)
+{
+    if (mirek <= COLOR_MIREK_MIN) {
+        return locus[0];
+    }
+    if (mirek >= COLOR_MIREK_MAX) {
+        return locus[LOCUS_POINTS - 1];
+    }
+    int i = (mirek - COLOR_MIREK_MIN) / LOCUS_STEP;
+    int frac = (mirek - COLOR_MIREK_MIN) % LOCUS_STEP;
+    const dali_xy &a = locus[i];
+    const dali_xy &b = locus[i + 1];
+    dali_xy xy;
+    xy.x = a.x + ((b.x - a.x) * frac) / LOCUS_STEP;
+    xy.y = a.y + ((b.y - a.y) * frac) / LOCUS_STEP;
+    return xy;
+}
+
+// Offset in mirek of the projection of p on the locus segment starting at
+// point i, -1 when p projects before the segment
+static int locus_offset(dali_xy p, int i)
+{
+    int32_t sx = locus[i + 1].x - locus[i].x;
+    int32_t sy = locus[i + 1].y - locus[i].y;
+    int32_t px = p.x - locus[i].x;
+    int32_t py = p.y - locus[i].y;
+    int32_t dot = px * sx + py * sy;
+    if (dot < 0) {
+        return -1;
+    }
+    uint32_t len = sx * sx + sy * sy;
+    if ((uint32_t)dot >= len) {
+        return LOCUS_STEP;
+    }
+    return color_ratio(dot, len, 4);
+}
+
+uint16_t color_xy_to_mirek(dali_xy xy)
+{
+    // Closest point of the table
+    int best = 0;
+    uint32_t best_dist = 0xFFFFFFFF;
+    for (int i = 0; i < LOCUS_POINTS; i++) {
+        // Halved so the sum fits in 32 bits
+        int32_t dx = (xy.x - locus[i].x) / 2;
+        int32_t dy = (xy.y - locus[i].y) / 2;
+        uint32_t dist = dx * dx + dy * dy;
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = i;
+        }
+    }
+    // Refine on the segment after or before it
+    int offset = best < LOCUS_POINTS - 1 ? locus_offset(xy, best) : -1;
+    if (offset < 0 && best > 0) {
+        best--;
+        offset = locus_offset(xy, best);
+    }
+    if (offset < 0) {
+        offset = 0;
+    }
+    return COLOR_MIREK_MIN + best * LOCUS_STEP + offset;
+}
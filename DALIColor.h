@@ -0,0 +1,113 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_COLOR_H
+#define DALI_COLOR_H
+
+// Fixed point colour conversions for DT8 gear, without floating point so
+// they can run in the event path of small MCUs. Kelvin and mirek convert
+// through a reciprocal table with 32 bit multiplies only, the chromaticity
+// conversions use one 32 bit divide per coordinate.
+//
+// Chromaticity uses the DT8 units: x and y coordinates of the CIE 1931
+// diagram in 1/65536. RGB values are linear channel levels of gear with sRGB
+// primaries and a D65 white point.
+
+#include <stdint.h>
+
+// Colour temperature range covered by the Planckian locus table
+#define COLOR_MIREK_MIN 40
+#define COLOR_MIREK_MAX 616
+
+// RGB colour with the level of the white, amber and freecolour channels
+struct dali_rgb {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t dim;
+};
+
+struct dali_xy {
+    uint16_t x;
+    uint16_t y;
+};
+
+// CIE 1976 u'v' chromaticity in 1/65536, where equal distances look about
+// equally different
+struct dali_uv {
+    uint16_t u;
+    uint16_t v;
+};
+
+/** Divide and round to nearest
+ *
+ *   @param n    Dividend, n + d / 2 must fit in 32 bits
+ *   @param d    Divisor, not 0
+ */
+uint32_t color_div(uint32_t n, uint16_t d);
+
+/** Convert a colour temperature from Kelvin to mirek, rounded
+ */
+uint16_t color_kelvin_to_mirek(uint16_t kelvin);
+
+/** Convert a colour temperature from mirek to Kelvin, rounded
+ */
+uint16_t color_mirek_to_kelvin(uint16_t mirek);
+
+/** Limit a colour temperature to the range of a device
+ *
+ *   @param mirek    Colour temperature in mirek
+ *   @param coolest  Coolest colour temperature in mirek (the smallest value)
+ *   @param warmest  Warmest colour temperature in mirek
+ */
+uint16_t color_clamp_mirek(uint16_t mirek, uint16_t coolest,
+                           uint16_t warmest);
+
+/** Get the chromaticity of linear RGB channel levels, D65 white for black
+ */
+dali_xy color_rgb_to_xy(uint8_t r, uint8_t g, uint8_t b);
+
+/** Get the brightest RGB channel levels (largest channel 254) of a
+ * chromaticity, colours outside the sRGB gamut are clipped
+ */
+dali_rgb color_xy_to_rgb(dali_xy xy);
+
+/** Convert a chromaticity from CIE 1931 xy to CIE 1976 u'v'
+ */
+dali_uv color_xy_to_uv(dali_xy xy);
+
+/** Convert a chromaticity from CIE 1976 u'v' to CIE 1931 xy
+ */
+dali_xy color_uv_to_xy(dali_uv uv);
+
+/** Get the chromaticity of a colour temperature on the Planckian locus
+ *
+ *   @param mirek    Colour temperature, limited to [COLOR_MIREK_MIN,
+ * COLOR_MIREK_MAX]
+ */
+dali_xy color_mirek_to_xy(uint16_t mirek);
+
+/** Get the correlated colour temperature of a chromaticity
+ *
+ *   NOTE: Uses the closest locus point in xy rather than uv isotherms, which
+ *   is within a few percent for colours near the locus
+ *
+ *   @returns    Mirek of the closest point on the Planckian locus, in
+ * [COLOR_MIREK_MIN, COLOR_MIREK_MAX]
+ */
+uint16_t color_xy_to_mirek(dali_xy xy);
+
+#endif
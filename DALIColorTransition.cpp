@@ -0,0 +1,378 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALIColorTransition.h"
+
+DALIColorTransition::DALIColorTransition(DALIDriver &dali, uint32_t tick_ms,
+                                         uint8_t bus_share)
+    : _dali(dali)
+{
+    _tick_us = tick_ms * 1000;
+    _bus_share = bus_share == 0 ? 1 : bus_share > 100 ? 100 : bus_share;
+    _next = 0;
+    cancel_all();
+}
+
+int DALIColorTransition::find_transition(uint8_t addr)
+{
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        if (_transitions[i].active && _transitions[i].addr == addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool DALIColorTransition::start(uint8_t addr, ColorType type,
+                                const uint16_t *from, const uint16_t *to,
+                                uint32_t duration_ms)
+{
+    int i = find_transition(addr);
+    if (i < 0) {
+        for (i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+            if (!_transitions[i].active) {
+                break;
+            }
+        }
+        if (i == COLOR_MAX_TRANSITIONS) {
+            return false;
+        }
+    }
+    color_transition &t = _transitions[i];
+    t.addr = addr;
+    t.type = type;
+    memcpy(t.from, from, sizeof(t.from));
+    memcpy(t.to, to, sizeof(t.to));
+    if (type == RGB) {
+        t.from_uv = color_xy_to_uv(color_rgb_to_xy(from[0], from[1], from[2]));
+        t.to_uv = color_xy_to_uv(color_rgb_to_xy(to[0], to[1], to[2]));
+    }
+    t.first = true;
+    t.start_us = _dali.encoder.now_us();
+    t.duration_us = duration_ms * 1000;
+    t.active = true;
+    return true;
+}
+
+bool DALIColorTransition::start_temperature(uint8_t addr, uint16_t from,
+                                            uint16_t to, uint32_t duration_ms)
+{
+    // Interpolate in mirek, same conversion as DALIDriver::set_color
+    uint16_t from_mirek[4] = {color_kelvin_to_mirek(from), 0, 0, 0};
+    uint16_t to_mirek[4] = {color_kelvin_to_mirek(to), 0, 0, 0};
+    return start(addr, TEMPERATURE, from_mirek, to_mirek, duration_ms);
+}
+
+bool DALIColorTransition::start_rgb(uint8_t addr, const dali_rgb &from,
+                                    const dali_rgb &to, uint32_t duration_ms)
+{
+    uint16_t from_levels[4] = {from.r, from.g, from.b, from.dim};
+    uint16_t to_levels[4] = {to.r, to.g, to.b, to.dim};
+    return start(addr, RGB, from_levels, to_levels, duration_ms);
+}
+
+void DALIColorTransition::cancel(uint8_t addr)
+{
+    int i = find_transition(addr);
+    if (i >= 0) {
+        _transitions[i].active = false;
+    }
+}
+
+void DALIColorTransition::cancel_all()
+{
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        _transitions[i].active = false;
+    }
+}
+
+bool DALIColorTransition::busy()
+{
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        if (_transitions[i].active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int32_t DALIColorTransition::interpolate(int32_t from, int32_t to,
+                                         uint32_t elapsed, uint32_t duration)
+{
+    int64_t step = ((int64_t)to - from) * elapsed;
+    // Round to the nearest step
+    int64_t half = duration / 2;
+    step = step >= 0 ? (step + half) / duration
+                     : (step - half) / (int64_t)duration;
+    return from + step;
+}
+
+void DALIColorTransition::value_at(const color_transition &t,
+                                   uint32_t elapsed, uint16_t *value)
+{
+    if (elapsed >= t.duration_us) {
+        memcpy(value, t.to, sizeof(t.to));
+        return;
+    }
+    if (elapsed == 0) {
+        memcpy(value, t.from, sizeof(t.from));
+        return;
+    }
+    uint32_t duration = t.duration_us;
+    if (t.type == TEMPERATURE) {
+        value[0] = interpolate(t.from[0], t.to[0], elapsed, duration);
+        value[1] = value[2] = value[3] = 0;
+        return;
+    }
+    // Chromaticity and brightness separately, then back to channel levels
+    dali_uv uv;
+    uv.u = interpolate(t.from_uv.u, t.to_uv.u, elapsed, duration);
+    uv.v = interpolate(t.from_uv.v, t.to_uv.v, elapsed, duration);
+    dali_rgb rgb = color_xy_to_rgb(color_uv_to_xy(uv));
+    uint16_t from_max = 0;
+    uint16_t to_max = 0;
+    for (int c = 0; c < 3; c++) {
+        from_max = t.from[c] > from_max ? t.from[c] : from_max;
+        to_max = t.to[c] > to_max ? t.to[c] : to_max;
+    }
+    uint32_t bright = interpolate(from_max, to_max, elapsed, duration);
+    value[0] = (rgb.r * bright + 127) / 254;
+    value[1] = (rgb.g * bright + 127) / 254;
+    value[2] = (rgb.b * bright + 127) / 254;
+    value[3] = interpolate(t.from[3], t.to[3], elapsed, duration);
+}
+
+int DALIColorTransition::frames_per_update(ColorType type)
+{
+    // DTR0, DTR1, then ENABLE_DEVICE_TYPE before SET_TEMP_TEMPC and
+    // COLOR_ACTIVATE
+    if (type == TEMPERATURE) {
+        return 6;
+    }
+    // DTR0-2 twice, for RGB and for the dim level with amber and freecolour
+    // masked, then ENABLE_DEVICE_TYPE before SET_TEMP_RGB_DIM,
+    // SET_TEMP_WAF_DIM and COLOR_ACTIVATE
+    return 12;
+}
+
+uint32_t DALIColorTransition::get_update_interval_ms()
+{
+    int frames = 0;
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        if (_transitions[i].active) {
+            frames += frames_per_update(_transitions[i].type);
+        }
+    }
+    // A frame occupies the bus for the frame and the settling time after it
+    uint32_t slot_us = _dali.encoder.frame_time_us(16) + 13500;
+    return (uint64_t)frames * slot_us * 100 / _bus_share / 1000;
+}
+
+int DALIColorTransition::send_temperature(const uint16_t *value,
+                                          const bool *batch)
+{
+    int frames = 2;
+    _dali.send_command_special(DTR0, value[0] & 0x00FF);
+    _dali.send_command_special(DTR1, value[0] >> 8);
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        if (batch[i]) {
+            _dali.send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+            _dali.send_command_standard(_transitions[i].addr, SET_TEMP_TEMPC);
+            frames += 2;
+        }
+    }
+    return frames;
+}
+
+int DALIColorTransition::send_rgb(const uint16_t *value, const bool *batch)
+{
+    int frames = 6;
+    _dali.send_command_special(DTR0, value[0]);
+    _dali.send_command_special(DTR1, value[1]);
+    _dali.send_command_special(DTR2, value[2]);
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        if (batch[i]) {
+            _dali.send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+            _dali.send_command_standard(_transitions[i].addr,
+                                        SET_TEMP_RGB_DIM);
+            frames += 2;
+        }
+    }
+    // Dim is the white channel, amber and freecolour are left alone
+    _dali.send_command_special(DTR0, value[3]);
+    _dali.send_command_special(DTR1, DALI_MASK);
+    _dali.send_command_special(DTR2, DALI_MASK);
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        if (batch[i]) {
+            _dali.send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+            _dali.send_command_standard(_transitions[i].addr,
+                                        SET_TEMP_WAF_DIM);
+            frames += 2;
+        }
+    }
+    return frames;
+}
+
+int DALIColorTransition::get_frames_per_tick()
+{
+    // A frame occupies the bus for the frame and the settling time after it
+    uint32_t slot_us = _dali.encoder.frame_time_us(16) + 13500;
+    return (uint64_t)_tick_us * _bus_share / 100 / slot_us;
+}
+
+int DALIColorTransition::shared_addr(const bool *batch)
+{
+    uint64_t set = 0;
+    int n = 0;
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        if (!batch[i]) {
+            continue;
+        }
+        if (_transitions[i].addr >= 64) {
+            return -1;
+        }
+        set |= (uint64_t)1 << _transitions[i].addr;
+        n++;
+    }
+    if (n < 2) {
+        return -1;
+    }
+    uint64_t lights = _dali.get_light_addresses();
+    if (set == lights) {
+        return DALIDriver::broadcast_addr;
+    }
+    // Only a group with no other members, the others would show their
+    // staged colours too
+    uint64_t members[16] = {0};
+    for (int addr = 0; addr < 64; addr++) {
+        uint16_t groups;
+        if (!(lights & ((uint64_t)1 << addr))) {
+            continue;
+        }
+        if (!_dali.get_groups(addr, groups)) {
+            return -1;
+        }
+        for (int g = 0; g < 16; g++) {
+            if (groups & (1 << g)) {
+                members[g] |= (uint64_t)1 << addr;
+            }
+        }
+    }
+    for (int g = 0; g < 16; g++) {
+        if (members[g] == set) {
+            return _dali.get_group_addr(g);
+        }
+    }
+    return -1;
+}
+
+int DALIColorTransition::tick()
+{
+    uint16_t value[COLOR_MAX_TRANSITIONS][4];
+    bool due[COLOR_MAX_TRANSITIONS];
+    uint32_t now = _dali.encoder.now_us();
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        color_transition &t = _transitions[i];
+        due[i] = false;
+        if (!t.active) {
+            continue;
+        }
+        value_at(t, now - t.start_us, value[i]);
+        due[i] = t.first || memcmp(value[i], t.sent, sizeof(t.sent)) != 0;
+    }
+
+    int budget = get_frames_per_tick();
+    int frames = 0;
+    int last = -1;
+    for (int n = 0; n < COLOR_MAX_TRANSITIONS; n++) {
+        int i = (_next + n) % COLOR_MAX_TRANSITIONS;
+        if (!due[i]) {
+            continue;
+        }
+        // Everything due with the same colour shares the DTR loads
+        bool batch[COLOR_MAX_TRANSITIONS] = {false};
+        int members = 0;
+        for (int j = 0; j < COLOR_MAX_TRANSITIONS; j++) {
+            if (due[j] && _transitions[j].type == _transitions[i].type &&
+                memcmp(value[j], value[i], sizeof(value[i])) == 0) {
+                batch[j] = true;
+                members++;
+            }
+        }
+        int shared = shared_addr(batch);
+        bool temperature = _transitions[i].type == TEMPERATURE;
+        // DTR loads, ENABLE_DEVICE_TYPE and SET_TEMP_ per member, then the
+        // activation
+        int cost = temperature ? 2 + 2 * members : 6 + 4 * members;
+        cost += shared >= 0 ? 2 : 2 * members;
+        // The first batch is always sent so every tick makes progress
+        if (frames && frames + cost > budget) {
+            break;
+        }
+        if (temperature) {
+            frames += send_temperature(value[i], batch);
+        } else {
+            frames += send_rgb(value[i], batch);
+        }
+        if (shared >= 0) {
+            _dali.send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+            _dali.send_command_standard(shared, COLOR_ACTIVATE);
+            frames += 2;
+        }
+        for (int j = 0; j < COLOR_MAX_TRANSITIONS; j++) {
+            if (batch[j]) {
+                if (shared < 0) {
+                    _dali.send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+                    _dali.send_command_standard(_transitions[j].addr,
+                                                COLOR_ACTIVATE);
+                    frames += 2;
+                }
+                memcpy(_transitions[j].sent, value[j], sizeof(value[j]));
+                _transitions[j].first = false;
+                due[j] = false;
+            }
+        }
+        last = i;
+    }
+    // Start after the last transition served so every address gets its turn
+    if (last >= 0) {
+        _next = (last + 1) % COLOR_MAX_TRANSITIONS;
+    }
+
+    for (int i = 0; i < COLOR_MAX_TRANSITIONS; i++) {
+        color_transition &t = _transitions[i];
+        if (t.active && !t.first && now - t.start_us >= t.duration_us &&
+            memcmp(t.sent, t.to, sizeof(t.to)) == 0) {
+            t.active = false;
+        }
+    }
+    return frames;
+}
+
+void DALIColorTransition::run()
+{
+    while (busy()) {
+        uint32_t start = _dali.encoder.now_us();
+        tick();
+        uint32_t elapsed = _dali.encoder.now_us() - start;
+        // Leave the rest of the bus time to other traffic
+        uint32_t wait = (uint64_t)elapsed * (100 - _bus_share) / _bus_share;
+        if (elapsed + wait < _tick_us) {
+            wait = _tick_us - elapsed;
+        }
+        _dali.encoder.idle(wait);
+    }
+}
@@ -0,0 +1,168 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_COLOR_TRANSITION_H
+#define DALI_COLOR_TRANSITION_H
+
+#include "DALIDriver.h"
+
+// Addresses changing colour at the same time
+#define COLOR_MAX_TRANSITIONS 16
+
+// One address changing colour
+struct color_transition {
+    // Short address, group address or broadcast_addr
+    uint8_t addr;
+    ColorType type;
+    // Mirek in value[0] for TEMPERATURE, r, g, b and dim for RGB
+    uint16_t from[4];
+    uint16_t to[4];
+    uint16_t sent[4];
+    // Chromaticity of from and to for RGB
+    dali_uv from_uv;
+    dali_uv to_uv;
+    // Nothing sent yet
+    bool first;
+    uint32_t start_us;
+    uint32_t duration_us;
+    bool active;
+};
+
+/** Changes the colour of DT8 gear gradually
+ *
+ * Colour temperature is interpolated in mirek, where equal steps look equally
+ * large. RGB colours are interpolated in CIE 1976 u'v' chromaticity, which
+ * unlike CIE 1931 xy is close to perceptually uniform, with the brightest
+ * channel interpolated by level, and converted back to channel levels at
+ * every step. Interpolating the channels one by one would pass through
+ * washed out and darker colours on the way.
+ *
+ * Every tick updates the transitions whose colour changed, with no more
+ * frames than the bus share allows in a tick; transitions are served round
+ * robin when the share is too small for all of them. Transitions that reached
+ * the same colour share the DTR loads, so a room of lights changing together
+ * costs little more than one. When the short addresses sharing a colour are
+ * all the lights, or exactly the members of a group, one broadcast or group
+ * COLOR_ACTIVATE shows the colour on all of them. Group membership is taken
+ * from the driver's group cache and read from the bus when not cached. After
+ * a tick the engine leaves the bus idle long enough to keep to its share of
+ * the bus time.
+ */
+class DALIColorTransition {
+public:
+    /** Constructor DALIColorTransition
+     *
+     *   @param dali         Driver used to send the frames
+     *   @param tick_ms      Shortest time between updates
+     *   @param bus_share    Percent of the bus time the transitions may use
+     */
+    DALIColorTransition(DALIDriver &dali, uint32_t tick_ms = 100,
+                        uint8_t bus_share = 50);
+
+    /** Change the colour temperature of an address
+     *
+     *   @param addr         Address as for DALIDriver::set_color
+     *   @param from         Colour temperature to start from in Kelvin
+     *   @param to           Target colour temperature in Kelvin
+     *   @param duration_ms  Length of the transition
+     *   @returns            false if all transitions are in use
+     */
+    bool start_temperature(uint8_t addr, uint16_t from, uint16_t to,
+                           uint32_t duration_ms);
+
+    /** Change the RGB colour of an address
+     *
+     *   @param addr         Address as for DALIDriver::set_color
+     *   @param from         Colour to start from
+     *   @param to           Target colour
+     *   @param duration_ms  Length of the transition
+     *   @returns            false if all transitions are in use
+     */
+    bool start_rgb(uint8_t addr, const dali_rgb &from, const dali_rgb &to,
+                   uint32_t duration_ms);
+
+    /** Stop the transition on an address, leaving the last colour sent
+     */
+    void cancel(uint8_t addr);
+
+    /** Stop all transitions
+     */
+    void cancel_all();
+
+    /** Check if any transition is running
+     */
+    bool busy();
+
+    /** Send the colours that changed since the last tick
+     *
+     *   Call from thread context, the frames block while sent. Colours that
+     *   do not fit in the frames of a tick are sent on the next ticks, at
+     *   least one colour is sent per tick.
+     *
+     *   @returns    Number of frames sent
+     */
+    int tick();
+
+    /** Tick until all transitions are finished, idling the bus to keep to
+     * the bus share
+     */
+    void run();
+
+    /** Get the shortest update interval the bus share sustains for the
+     * running transitions, when none of them share a colour
+     *
+     *   @returns    Interval in milliseconds
+     */
+    uint32_t get_update_interval_ms();
+
+    /** Get the number of frames each tick may send
+     */
+    int get_frames_per_tick();
+
+private:
+    bool start(uint8_t addr, ColorType type, const uint16_t *from,
+               const uint16_t *to, uint32_t duration_ms);
+
+    int find_transition(uint8_t addr);
+
+    // Colour the transition should have after elapsed microseconds
+    void value_at(const color_transition &t, uint32_t elapsed,
+                  uint16_t *value);
+
+    // Value between from and to, elapsed out of duration microseconds
+    static int32_t interpolate(int32_t from, int32_t to, uint32_t elapsed,
+                               uint32_t duration);
+
+    // Send a colour to the transitions marked in batch
+    int send_temperature(const uint16_t *value, const bool *batch);
+    int send_rgb(const uint16_t *value, const bool *batch);
+
+    // Frames sent for one transition that shares its colour with no other
+    static int frames_per_update(ColorType type);
+
+    // Broadcast or group address covering exactly the short addresses in
+    // batch, -1 if there is none
+    int shared_addr(const bool *batch);
+
+    DALIDriver &_dali;
+    uint32_t _tick_us;
+    uint8_t _bus_share;
+    // Transition to serve first on the next tick
+    int _next;
+    color_transition _transitions[COLOR_MAX_TRANSITIONS];
+};
+
+#endif
@@ -0,0 +1,101 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_COMMANDS_H
+#define DALI_COMMANDS_H
+
+// Command encodings shared by the driver and the host tools, this header must
+// not depend on mbed
+
+// Special commands that do not address a specific device
+// These values will be used as address byte in DALI command
+enum SpecialCommandOpAddr {
+    SEARCHADDRH = 0xB1,
+    SEARCHADDRM = 0xB3,
+    SEARCHADDRL = 0xB5,
+    DTR0 = 0xA3,
+    DTR1 = 0xC3,
+    DTR2 = 0xC5,
+    INITIALISE = 0xA5,
+    RANDOMISE = 0xA7,
+    PROGRAM_SHORT_ADDR = 0xB7,
+    QUERY_SHORT_ADDR = 0xBB,
+    COMPARE = 0xA9,
+    TERMINATE = 0xA1,
+    ENABLE_DEVICE_TYPE = 0xC1,
+    WITHDRAW = 0xAB
+};
+
+// MASK value: no change for DT8 colour channels, not part of a scene
+#define DALI_MASK 0xFF
+
+// DTR0 selectors of the DT8 QUERY COLOR VALUE command
+enum ColorValueSelector {
+    COLOR_VALUE_TC_COOLEST = 0x80,
+    COLOR_VALUE_TC_PHYS_COOLEST = 0x81,
+    COLOR_VALUE_TC_WARMEST = 0x82,
+    COLOR_VALUE_TC_PHYS_WARMEST = 0x83
+};
+
+// Command op codes
+enum CommandOpCodes {
+    GO_TO_SCENE = 0x10,
+    OFF = 0x00,
+    ON_AND_STEP_UP = 0x08,
+    QUERY_GEAR_GROUPS_L = 0xC0, // get lower byte of gear groups status
+    QUERY_GEAR_GROUPS_H = 0xC1, // get upper byte of gear groups status
+    QUERY_ACTUAL_LEVEL = 0xA0,
+    QUERY_ERROR = 0x90,
+    // Yes/no queries, only control gear for which the answer is yes answer
+    QUERY_CONTROL_GEAR_PRESENT = 0x91,
+    QUERY_LAMP_FAILURE = 0x92,
+    QUERY_LAMP_POWER_ON = 0x93,
+    QUERY_PHM = 0x9A,
+    QUERY_FADE = 0xA5,
+    QUERY_COLOR_TYPE_FEATURES = 0xF9,
+    QUERY_SCENE_LEVEL = 0xB0,
+    READ_MEM_LOC = 0xC5,
+    SET_TEMP_RGB_DIM = 0xEB,
+    SET_TEMP_TEMPC = 0xE7,
+    SET_TEMP_WAF_DIM = 0xEC,
+    COLOR_ACTIVATE = 0xE2,
+    SET_TEMP_X_COORD = 0xE0,
+    SET_TEMP_Y_COORD = 0xE1,
+    QUERY_COLOR_VALUE = 0xFA,
+    QUERY_CONTENT_DTR0 = 0x98,
+    COPY_REPORT_TO_TEMP = 0xEE,
+    QUERY_MAX_LEVEL = 0xA1,
+    QUERY_MIN_LEVEL = 0xA2,
+    QUERY_POWER_ON_LEVEL = 0xA3,
+    QUERY_SYSTEM_FAILURE_LEVEL = 0xA4,
+
+    // Commands below are "send twice"
+    SET_SCENE = 0x40,
+    SET_FADE_TIME = 0x2E,
+    SET_FADE_RATE = 0x2F,
+    SET_MIN_LEVEL = 0x2B,
+    REMOVE_FROM_SCENE = 0x50,
+    REMOVE_FROM_GROUP = 0x70,
+    STORE_DTR_AS_SCENE =0x40,
+    ADD_TO_GROUP = 0x60,
+    SET_SHORT_ADDR = 0x80,
+    SET_MAX_LEVEL = 0x2A,
+    SET_SYSTEM_FAILURE_LEVEL = 0x2C,
+    SET_POWER_ON_LEVEL = 0x2D,
+    STORE_ACTUAL_LEVEL_IN_DTR0 = 0x21
+};
+
+#endif
@@ -0,0 +1,167 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_CURVE_H
+#define DALI_CURVE_H
+
+// Conversions between arc power levels and light output, usable in constant
+// expressions and without libm or floating point
+//
+// Light output is given in parts per million of full output (ppm), percent,
+// or a Q16 fraction where 65536 is full output. Level 0 is off, any non zero
+// output maps to at least level 1 so the light stays on.
+
+#include <stdint.h>
+
+enum DALICurveType {
+    // Standard curve of iec62386-102 section 9.3:
+    // X(n) = 10 ^ ((n - 1) / (253 / 3) - 1) %
+    CURVE_LOGARITHMIC,
+    // Linear curve of DALI-2 gear: X(n) = n / 2.54 %
+    CURVE_LINEAR
+};
+
+// Output of each level on the logarithmic curve in ppm, rounded
+constexpr uint32_t dali_log_curve_ppm[255] = {
+    0, 1000, 1028, 1056, 1085, 1115, 1146, 1178,
+    1211, 1244, 1279, 1314, 1350, 1388, 1426, 1466,
+    1506, 1548, 1591, 1635, 1680, 1726, 1774, 1823,
+    1874, 1926, 1979, 2034, 2090, 2148, 2207, 2268,
+    2331, 2396, 2462, 2530, 2600, 2672, 2746, 2822,
+    2900, 2981, 3063, 3148, 3235, 3325, 3417, 3511,
+    3608, 3708, 3811, 3916, 4025, 4136, 4251, 4368,
+    4489, 4614, 4741, 4872, 5007, 5146, 5288, 5435,
+    5585, 5740, 5899, 6062, 6230, 6402, 6579, 6761,
+    6949, 7141, 7339, 7542, 7750, 7965, 8185, 8412,
+    8645, 8884, 9130, 9383, 9643, 9909, 10184, 10466,
+    10755, 11053, 11359, 11673, 11996, 12328, 12670, 13020,
+    13381, 13751, 14132, 14523, 14925, 15338, 15763, 16199,
+    16647, 17108, 17582, 18068, 18568, 19082, 19611, 20153,
+    20711, 21284, 21874, 22479, 23101, 23741, 24398, 25073,
+    25767, 26480, 27213, 27967, 28741, 29536, 30354, 31194,
+    32057, 32945, 33857, 34794, 35757, 36747, 37764, 38809,
+    39883, 40987, 42122, 43288, 44486, 45717, 46983, 48283,
+    49619, 50993, 52404, 53855, 55346, 56878, 58452, 60070,
+    61732, 63441, 65197, 67002, 68856, 70762, 72721, 74734,
+    76803, 78928, 81113, 83358, 85666, 88037, 90474, 92978,
+    95551, 98196, 100914, 103708, 106578, 109528, 112560, 115675,
+    118877, 122168, 125549, 129024, 132596, 136266, 140038, 143914,
+    147897, 151991, 156198, 160522, 164965, 169531, 174223, 179046,
+    184002, 189095, 194329, 199708, 205236, 210917, 216755, 222754,
+    228920, 235256, 241768, 248460, 255338, 262405, 269668, 277133,
+    284804, 292687, 300788, 309114, 317670, 326463, 335499, 344786,
+    354329, 364137, 374216, 384574, 395219, 406159, 417401, 428954,
+    440828, 453029, 465569, 478456, 491699, 505309, 519296, 533670,
+    548442, 563622, 579223, 595256, 611732, 628665, 646066, 663948,
+    682326, 701213, 720622, 740568, 761067, 782133, 803782, 826030,
+    848895, 872392, 896539, 921355, 946857, 973066, 1000000
+};
+
+// Lowest level in [lo, hi] with a logarithmic output of at least ppm
+constexpr uint8_t dali_log_lower_bound(uint32_t ppm, int lo, int hi)
+{
+    return lo >= hi ? lo
+           : dali_log_curve_ppm[(lo + hi) / 2] < ppm
+               ? dali_log_lower_bound(ppm, (lo + hi) / 2 + 1, hi)
+               : dali_log_lower_bound(ppm, lo, (lo + hi) / 2);
+}
+
+// Level n or the one below it, whichever output is closer to ppm
+constexpr uint8_t dali_log_nearest(uint32_t ppm, uint8_t n)
+{
+    return n > 1 && ppm - dali_log_curve_ppm[n - 1] <
+                        dali_log_curve_ppm[n] - ppm
+               ? n - 1
+               : n;
+}
+
+// Linear level n, at least level 1
+constexpr uint8_t dali_linear_nearest(uint32_t n)
+{
+    return n ? n : 1;
+}
+
+/** Get the light output of an arc power level
+ *
+ *   @param arc      Level [0,254], higher values are taken as 254
+ *   @param curve    Dimming curve of the gear
+ *   @returns        Output in ppm of full output
+ */
+constexpr uint32_t dali_arc_to_ppm(uint8_t arc,
+                                   DALICurveType curve = CURVE_LOGARITHMIC)
+{
+    return arc > 254 ? 1000000
+           : curve == CURVE_LINEAR ? ((uint32_t)arc * 1000000 + 127) / 254
+                                   : dali_log_curve_ppm[arc];
+}
+
+/** Get the arc power level closest to a light output
+ *
+ *   @param ppm      Output in ppm of full output
+ *   @param curve    Dimming curve of the gear
+ *   @returns        Level [0,254]
+ */
+constexpr uint8_t dali_ppm_to_arc(uint32_t ppm,
+                                  DALICurveType curve = CURVE_LOGARITHMIC)
+{
+    return ppm == 0 ? 0
+           : ppm >= 1000000 ? 254
+           : curve == CURVE_LINEAR
+               ? dali_linear_nearest((ppm * 254 + 500000) / 1000000)
+               : dali_log_nearest(ppm, dali_log_lower_bound(ppm, 1, 254));
+}
+
+/** Get the light output of an arc power level in percent, rounded
+ */
+constexpr uint8_t dali_arc_to_percent(uint8_t arc,
+                                      DALICurveType curve = CURVE_LOGARITHMIC)
+{
+    return (dali_arc_to_ppm(arc, curve) + 5000) / 10000;
+}
+
+/** Get the arc power level closest to a light output in percent
+ */
+constexpr uint8_t dali_percent_to_arc(uint8_t percent,
+                                      DALICurveType curve = CURVE_LOGARITHMIC)
+{
+    return dali_ppm_to_arc(percent > 100 ? 1000000 : percent * 10000, curve);
+}
+
+/** Get the light output of an arc power level as a Q16 fraction
+ */
+constexpr uint32_t dali_arc_to_fraction(uint8_t arc,
+                                        DALICurveType curve = CURVE_LOGARITHMIC)
+{
+    // 65536 / 1000000 = 1024 / 15625
+    return (dali_arc_to_ppm(arc, curve) * 1024 + 7812) / 15625;
+}
+
+/** Get the arc power level closest to a Q16 light output fraction
+ */
+constexpr uint8_t dali_fraction_to_arc(uint32_t fraction,
+                                       DALICurveType curve = CURVE_LOGARITHMIC)
+{
+    return dali_ppm_to_arc(
+        fraction >= 65536 ? 1000000 : (fraction * 15625 + 512) / 1024, curve);
+}
+
+static_assert(dali_percent_to_arc(100) == 254, "curve end");
+static_assert(dali_percent_to_arc(1) == 85, "1% is level 85");
+static_assert(dali_percent_to_arc(10) == 170, "10% is level 170");
+static_assert(dali_ppm_to_arc(dali_arc_to_ppm(2)) == 2, "curve start");
+static_assert(dali_fraction_to_arc(32768, CURVE_LINEAR) == 127, "linear");
+
+#endif
@@ -20,14 +20,96 @@ DALIDriver::DALIDriver(PinName out_pin, PinName in_pin, int baud,
                        bool idle_state)
     : encoder(out_pin, in_pin, baud, idle_state)
 {
+    _scope = NULL;
+    reset_stats();
+    set_level_filter(0);
+    // All bytes 0xFF, -1 in every slot
+    memset(_level_sent, 0xFF, sizeof(_level_sent));
+    memset(_level_pending, 0xFF, sizeof(_level_pending));
+    _levels_held = 0;
+    _level_due_us = 0;
+    memset(_tc_coolest, 0, sizeof(_tc_coolest));
+    memset(_tc_warmest, 0, sizeof(_tc_warmest));
+    memset(_rgbwaf, DALI_MASK, sizeof(_rgbwaf));
+    _scene_cache = NULL;
+    _groups_known = 0;
+    _groups_seen = 0;
+    _config_known = 0;
+    memset(_phm, 0, sizeof(_phm));
+    _batch_count = 0;
+    _batch_depth = 0;
+    num_lights = 0;
+    num_inputs = 0;
+    inputs_start = 0;
+    _light_addrs = 0;
+    _input_addrs = 0;
+    _identity_map = NULL;
 }
 
 DALIDriver::~DALIDriver()
 {
 }
 
+DALIDriver::ApiScope::ApiScope(DALIDriver *driver, DALIApi api)
+    : _driver(driver), _api(api)
+{
+    _outer = driver->_scope;
+    driver->_scope = this;
+    _start_us = driver->encoder.now_us();
+    _start_frames = driver->encoder.get_frame_count();
+    _start_answers = driver->encoder.get_received_count();
+    _nested_us = 0;
+    _nested_frames = 0;
+    _nested_answers = 0;
+}
+
+DALIDriver::ApiScope::~ApiScope()
+{
+    dali_api_stats &stats = _driver->_stats.api[_api];
+    uint32_t elapsed = _driver->encoder.now_us() - _start_us;
+    uint32_t frames = _driver->encoder.get_frame_count() - _start_frames;
+    uint32_t answers = _driver->encoder.get_received_count() - _start_answers;
+    stats.calls++;
+    stats.frames += frames;
+    stats.answers += answers;
+    stats.total_us += elapsed;
+    stats.own_frames += frames - _nested_frames;
+    stats.own_answers += answers - _nested_answers;
+    stats.own_us += elapsed - _nested_us;
+    _driver->_scope = _outer;
+    if (_outer) {
+        _outer->_nested_us += elapsed;
+        _outer->_nested_frames += frames;
+        _outer->_nested_answers += answers;
+    }
+    if (elapsed > stats.max_us) {
+        stats.max_us = elapsed;
+    }
+    // Bucket i holds calls shorter than 32.768 ms << i
+    int bucket = 0;
+    uint32_t units = elapsed >> 15;
+    while (units && bucket < DALI_LATENCY_BUCKETS - 1) {
+        units >>= 1;
+        bucket++;
+    }
+    stats.latency[bucket]++;
+}
+
+void DALIDriver::get_stats(dali_stats &stats)
+{
+    stats = _stats;
+    encoder.get_stats(stats.bus);
+}
+
+void DALIDriver::reset_stats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+    encoder.reset_stats();
+}
+
 bool DALIDriver::add_to_group(uint8_t addr, uint8_t group)
 {
+    ApiScope scope(this, API_ADD_TO_GROUP);
     // Send the command to add to group
     send_twice(addr, ADD_TO_GROUP + group);
     // Query upper or lower bits of gearGroups 16 bit variable
@@ -35,7 +117,9 @@ bool DALIDriver::add_to_group(uint8_t addr, uint8_t group)
     // Send query command
     send_command_standard(addr, cmd);
     // Receive gearGroups variable
-    uint8_t resp = encoder.recv();
+    int answer = encoder.recv();
+    update_groups(addr, group, true, answer);
+    uint8_t resp = answer;
     // Group bit will be set if this light is a memeber of that group
     uint8_t mask = 1 << (group % 8);
     bool contained = resp & mask;
@@ -45,6 +129,7 @@ bool DALIDriver::add_to_group(uint8_t addr, uint8_t group)
 
 bool DALIDriver::remove_from_group(uint8_t addr, uint8_t group)
 {
+    ApiScope scope(this, API_REMOVE_FROM_GROUP);
     // Send the command to remove from group
     send_twice(addr, REMOVE_FROM_GROUP + group);
     // Query upper or lower bits of gearGroups 16 bit variable
@@ -52,7 +137,9 @@ bool DALIDriver::remove_from_group(uint8_t addr, uint8_t group)
     // Send query command
     send_command_standard(addr, cmd);
     // Receive gearGroups variable
-    uint8_t resp = encoder.recv();
+    int answer = encoder.recv();
+    update_groups(addr, group, false, answer);
+    uint8_t resp = answer;
     // Group bit will be set if this light is a memeber of that group
     uint8_t mask = 1 << (group % 8);
     bool contained = resp & mask;
@@ -60,18 +147,417 @@ bool DALIDriver::remove_from_group(uint8_t addr, uint8_t group)
     return !contained;
 }
 
+void DALIDriver::update_groups(uint8_t addr, uint8_t group, bool add,
+                               int resp)
+{
+    if (addr >= 64) {
+        // The answers of several lights collide, but the lights the command
+        // reached follow from the groups cached for them
+        for (int light = 0; light < 64; light++) {
+            uint64_t bit = (uint64_t)1 << light;
+            bool reached = addr == broadcast_addr ||
+                           ((addr & 0xF0) == 0x80 &&
+                            ((_groups[light] >> (addr & 0x0F)) & 1));
+            if (!((_groups_known | _groups_seen) & bit) || !reached) {
+                continue;
+            }
+            _groups[light] = add ? _groups[light] | (1 << group)
+                                 : _groups[light] & ~(1 << group);
+        }
+        return;
+    }
+    uint64_t bit = (uint64_t)1 << addr;
+    if (resp < 0) {
+        // The last groups read are kept for restore_address
+        _groups_known &= ~bit;
+        return;
+    }
+    if (!(_groups_known & bit)) {
+        return;
+    }
+    // Take the whole byte the gear answered
+    int shift = group < 8 ? 0 : 8;
+    _groups[addr] = (_groups[addr] & ~(0xFF << shift)) | (resp << shift);
+}
+
+bool DALIDriver::read_group_membership(uint8_t addr)
+{
+    ApiScope scope(this, API_READ_GROUP_MEMBERSHIP);
+    if (addr >= 64) {
+        return false;
+    }
+    uint64_t bit = (uint64_t)1 << addr;
+    _groups_known &= ~bit;
+    send_command_standard(addr, QUERY_GEAR_GROUPS_L);
+    int low = encoder.recv();
+    if (low < 0) {
+        return false;
+    }
+    send_command_standard(addr, QUERY_GEAR_GROUPS_H);
+    int high = encoder.recv();
+    if (high < 0) {
+        return false;
+    }
+    _groups[addr] = (high << 8) | low;
+    _groups_known |= bit;
+    _groups_seen |= bit;
+    return true;
+}
+
+bool DALIDriver::get_groups(uint8_t addr, uint16_t &groups)
+{
+    if (addr >= 64) {
+        return false;
+    }
+    if (!(_groups_known & ((uint64_t)1 << addr)) &&
+        !read_group_membership(addr)) {
+        return false;
+    }
+    groups = _groups[addr];
+    return true;
+}
+
+int DALIDriver::send_group_changes(uint64_t lights, uint64_t change,
+                                   const uint16_t *desired)
+{
+    int pairs = 0;
+    // Adds first, so a group that moves can still be addressed by its old
+    // group address
+    for (int add = 1; add >= 0; add--) {
+        for (int g = 0; g < 16; g++) {
+            uint16_t bit = 1 << g;
+            uint8_t opcode = (add ? ADD_TO_GROUP : REMOVE_FROM_GROUP) + g;
+            // Lights that need the command, and lights it would not harm
+            uint64_t need = 0;
+            uint64_t fine = 0;
+            for (int addr = 0; addr < 64; addr++) {
+                uint64_t a = (uint64_t)1 << addr;
+                if (!(lights & a)) {
+                    continue;
+                }
+                bool want = (desired[addr] & bit) != 0;
+                bool has = (_groups[addr] & bit) != 0;
+                if (want == (add != 0)) {
+                    fine |= a;
+                    if (want != has && (change & a)) {
+                        need |= a;
+                    }
+                }
+            }
+            while (need) {
+                // Broadcast (source 16) or the group that covers the most
+                // lights needing the command without touching the others
+                int best = -1;
+                int best_count = 1;
+                uint64_t best_members = 0;
+                for (int source = 0; source <= 16; source++) {
+                    uint64_t members = 0;
+                    for (int addr = 0; addr < 64; addr++) {
+                        if ((lights & ((uint64_t)1 << addr)) &&
+                            (source == 16 || (_groups[addr] >> source) & 1)) {
+                            members |= (uint64_t)1 << addr;
+                        }
+                    }
+                    if (!members || (members & ~fine)) {
+                        continue;
+                    }
+                    int count = 0;
+                    for (uint64_t m = members & need; m; m &= m - 1) {
+                        count++;
+                    }
+                    if (count > best_count) {
+                        best = source;
+                        best_count = count;
+                        best_members = members;
+                    }
+                }
+                if (best < 0) {
+                    break;
+                }
+                send_twice(best == 16 ? broadcast_addr : get_group_addr(best),
+                           opcode);
+                pairs++;
+                for (int addr = 0; addr < 64; addr++) {
+                    if (best_members & ((uint64_t)1 << addr)) {
+                        _groups[addr] = add ? _groups[addr] | bit
+                                            : _groups[addr] & ~bit;
+                    }
+                }
+                need &= ~best_members;
+            }
+            for (int addr = 0; addr < 64; addr++) {
+                if (need & ((uint64_t)1 << addr)) {
+                    send_twice(addr, opcode);
+                    pairs++;
+                    _groups[addr] = add ? _groups[addr] | bit
+                                        : _groups[addr] & ~bit;
+                }
+            }
+        }
+    }
+    return pairs;
+}
+
+int DALIDriver::apply_group_membership(const uint8_t *addrs,
+                                       const uint16_t *masks, uint8_t n)
+{
+    ApiScope scope(this, API_APPLY_GROUP_MEMBERSHIP);
+    uint16_t desired[64];
+    uint64_t change = 0;
+    // Lights whose groups are known, group addresses may only be used when
+    // every light on the bus is
+    uint64_t lights = 0;
+    bool all_known = true;
+    for (int addr = 0; addr < 64; addr++) {
+        if (!(_light_addrs & ((uint64_t)1 << addr))) {
+            continue;
+        }
+        uint16_t groups;
+        if (get_groups(addr, groups)) {
+            desired[addr] = groups;
+            lights |= (uint64_t)1 << addr;
+        } else {
+            all_known = false;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        uint16_t groups;
+        if (addrs[i] >= 64 || !get_groups(addrs[i], groups)) {
+            continue;
+        }
+        desired[addrs[i]] = masks[i];
+        change |= (uint64_t)1 << addrs[i];
+        lights |= (uint64_t)1 << addrs[i];
+    }
+    if (all_known) {
+        send_group_changes(lights, change, desired);
+    } else {
+        // Only short addresses, every light counts as touched by a group
+        for (int g = 0; g < 16; g++) {
+            for (int addr = 0; addr < 64; addr++) {
+                uint16_t bit = 1 << g;
+                if (!(change & ((uint64_t)1 << addr)) ||
+                    (desired[addr] & bit) == (_groups[addr] & bit)) {
+                    continue;
+                }
+                bool add = desired[addr] & bit;
+                send_twice(addr, (add ? ADD_TO_GROUP : REMOVE_FROM_GROUP) + g);
+                _groups[addr] ^= bit;
+            }
+        }
+    }
+
+    // One readback per device, then one retry of what did not stick
+    int ok = 0;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        ok = 0;
+        uint64_t wrong = 0;
+        for (int addr = 0; addr < 64; addr++) {
+            if (!(change & ((uint64_t)1 << addr))) {
+                continue;
+            }
+            if (read_group_membership(addr) &&
+                _groups[addr] == desired[addr]) {
+                ok++;
+            } else {
+                wrong |= (uint64_t)1 << addr;
+            }
+        }
+        if (!wrong || attempt == 1) {
+            break;
+        }
+        for (int addr = 0; addr < 64; addr++) {
+            if (!(wrong & ((uint64_t)1 << addr)) ||
+                !(_groups_known & ((uint64_t)1 << addr))) {
+                continue;
+            }
+            uint16_t diff = _groups[addr] ^ desired[addr];
+            for (int g = 0; g < 16; g++) {
+                if (diff & (1 << g)) {
+                    bool add = desired[addr] & (1 << g);
+                    send_twice(addr,
+                               (add ? ADD_TO_GROUP : REMOVE_FROM_GROUP) + g);
+                    _stats.retries++;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
 void DALIDriver::set_level(uint8_t addr, uint8_t level)
 {
-    send_command_direct(addr, level);
+    ApiScope scope(this, API_SET_LEVEL);
+    tick();
+    int index = level_filter_index(addr);
+    if (!_filter_threshold || index < 0) {
+        send_command_direct(addr, level);
+        return;
+    }
+    if (level == DALI_MASK) {
+        // Leaves the level alone, nothing to track or hold back
+        send_direct(addr, level);
+        return;
+    }
+    uint32_t now = encoder.now_us();
+    if (!level_visible(_level_sent[index], level)) {
+        if (level == _level_sent[index]) {
+            // Back where the light already is
+            release_level(index);
+            _stats.suppressed_levels++;
+            return;
+        }
+        if (_level_pending[index] < 0) {
+            _level_pending_us[index] = now;
+            uint32_t due = now + _filter_hold_us;
+            if (!_levels_held || (int32_t)(due - _level_due_us) < 0) {
+                _level_due_us = due;
+            }
+            _levels_held++;
+        }
+        _level_pending[index] = level;
+        if (now - _level_pending_us[index] < _filter_hold_us) {
+            _stats.suppressed_levels++;
+            return;
+        }
+    }
+    level_override(addr);
+    send_direct(addr, level);
+    _level_sent[index] = level;
+}
+
+void DALIDriver::set_level_filter(uint8_t threshold, LevelFilterUnit unit,
+                                  uint32_t max_hold_ms)
+{
+    if (threshold && !_filter_threshold) {
+        // Levels were not tracked while the filter was off
+        memset(_level_sent, 0xFF, sizeof(_level_sent));
+    }
+    _filter_threshold = threshold;
+    _filter_unit = unit;
+    _filter_hold_us = max_hold_ms * 1000;
+}
+
+int DALIDriver::flush_levels(uint32_t max_age_ms)
+{
+    if (!_levels_held) {
+        return 0;
+    }
+    uint32_t now = encoder.now_us();
+    int sent = 0;
+    for (int i = 0; i < LEVEL_FILTER_ADDRS; i++) {
+        if (_level_pending[i] >= 0 &&
+            now - _level_pending_us[i] >= max_age_ms * 1000) {
+            flush_level(i);
+            sent++;
+        }
+    }
+    // Earliest deadline of the levels still held
+    bool first = true;
+    for (int i = 0; i < LEVEL_FILTER_ADDRS && _levels_held; i++) {
+        uint32_t due = _level_pending_us[i] + _filter_hold_us;
+        if (_level_pending[i] >= 0 &&
+            (first || (int32_t)(due - _level_due_us) < 0)) {
+            _level_due_us = due;
+            first = false;
+        }
+    }
+    return sent;
+}
+
+int DALIDriver::tick()
+{
+    if (!_levels_held ||
+        (int32_t)(encoder.now_us() - _level_due_us) < 0) {
+        return 0;
+    }
+    return flush_levels(_filter_hold_us / 1000);
+}
+
+void DALIDriver::release_level(int index)
+{
+    if (_level_pending[index] >= 0) {
+        _level_pending[index] = -1;
+        _levels_held--;
+    }
+}
+
+int DALIDriver::level_filter_index(uint8_t addr)
+{
+    if (addr >= 0xFE) {
+        return LEVEL_FILTER_ADDRS - 1;
+    }
+    if (addr & 0x80) {
+        return 64 + (addr & 0x0F);
+    }
+    return addr < 64 ? addr : -1;
+}
+
+bool DALIDriver::level_visible(int16_t last, uint8_t level)
+{
+    // Unknown, turning off or turning on
+    if (last < 0 || last == 0 || level == 0) {
+        return last != level;
+    }
+    if (_filter_unit == FILTER_STEPS) {
+        int diff = level > last ? level - last : last - level;
+        return diff >= _filter_threshold;
+    }
+    uint32_t a = dali_arc_to_ppm(last);
+    uint32_t b = dali_arc_to_ppm(level);
+    uint32_t diff = a > b ? a - b : b - a;
+    // Relative to the brighter one, in percent
+    return (uint64_t)diff * 100 >= (uint64_t)_filter_threshold * (a > b ? a : b);
+}
+
+void DALIDriver::flush_level(int index)
+{
+    uint8_t addr = index < 64 ? index
+                   : index < LEVEL_FILTER_ADDRS - 1 ? get_group_addr(index - 64)
+                                                    : broadcast_addr;
+    uint8_t level = _level_pending[index];
+    level_override(addr);
+    send_direct(addr, level);
+    _level_sent[index] = level;
+}
+
+void DALIDriver::level_override(uint8_t addr)
+{
+    if (!_filter_threshold && !_levels_held) {
+        // Nothing tracked, see set_level_filter
+        return;
+    }
+    int index = level_filter_index(addr);
+    if (index < 0) {
+        return;
+    }
+    release_level(index);
+    // Levels held back on slots sharing gear with addr go out first. Short
+    // addresses only share gear with groups and broadcast, group membership
+    // is not known so groups share with every slot.
+    for (int i = 0; i < LEVEL_FILTER_ADDRS; i++) {
+        if (_level_pending[i] >= 0 && (i >= 64 || index >= 64)) {
+            flush_level(i);
+        }
+    }
+    if (index < 64) {
+        _level_sent[index] = -1;
+        memset(&_level_sent[64], 0xFF,
+               (LEVEL_FILTER_ADDRS - 64) * sizeof(_level_sent[0]));
+    } else {
+        memset(_level_sent, 0xFF, sizeof(_level_sent));
+    }
 }
 
 void DALIDriver::turn_off(uint8_t addr)
 {
+    ApiScope scope(this, API_TURN_OFF);
     send_command_standard(addr, OFF);
 }
 
 uint8_t DALIDriver::get_level(uint8_t addr)
 {
+    ApiScope scope(this, API_GET_LEVEL);
     send_command_standard(addr, QUERY_ACTUAL_LEVEL);
     uint8_t resp = encoder.recv();
     return resp;
@@ -79,6 +565,7 @@ uint8_t DALIDriver::get_level(uint8_t addr)
 
 uint8_t DALIDriver::get_error(uint8_t addr)
 {
+    ApiScope scope(this, API_GET_ERROR);
     send_command_standard(addr, QUERY_ERROR);
     uint8_t resp = encoder.recv();
     return resp & 0x03;
@@ -86,6 +573,7 @@ uint8_t DALIDriver::get_error(uint8_t addr)
 
 uint8_t DALIDriver::get_phm(uint8_t addr)
 {
+    ApiScope scope(this, API_GET_PHM);
     send_command_standard(addr, QUERY_PHM);
     uint8_t resp = encoder.recv();
     return resp;
@@ -93,11 +581,142 @@ uint8_t DALIDriver::get_phm(uint8_t addr)
 
 uint8_t DALIDriver::get_fade(uint8_t addr)
 {
+    ApiScope scope(this, API_GET_FADE);
     send_command_standard(addr, QUERY_FADE);
     uint8_t resp = encoder.recv();
     return resp;
 }
 
+bool DALIDriver::query_any(uint8_t addr, uint8_t opcode)
+{
+    ApiScope scope(this, API_QUERY_ANY);
+    send_command_standard(addr, opcode);
+    // Several answers collide, any activity on the bus is a yes
+    return encoder.recv() >= 0;
+}
+
+uint64_t DALIDriver::find_answering(uint8_t opcode)
+{
+    ApiScope scope(this, API_FIND_ANSWERING);
+    if (!query_any(broadcast_addr, opcode)) {
+        return 0;
+    }
+    uint64_t known = _light_addrs & _groups_known;
+    uint64_t yes = 0;
+    // Lights with unknown groups can only be asked one by one
+    for (int addr = 0; addr < 64; addr++) {
+        uint64_t bit = (uint64_t)1 << addr;
+        if ((_light_addrs & ~known & bit) && query_any(addr, opcode)) {
+            yes |= bit;
+        }
+    }
+    // Members of each group among the lights with known groups
+    uint64_t members[16];
+    memset(members, 0, sizeof(members));
+    for (int addr = 0; addr < 64; addr++) {
+        if (!(known & ((uint64_t)1 << addr))) {
+            continue;
+        }
+        for (int g = 0; g < 16; g++) {
+            if (_groups[addr] & (1 << g)) {
+                members[g] |= (uint64_t)1 << addr;
+            }
+        }
+    }
+    if (yes) {
+        // A light that answered may be in any group and answer for it, the
+        // rest is asked one by one
+        memset(members, 0, sizeof(members));
+        uint64_t no = 0;
+        return yes | narrow_answering(opcode, known, false, members, no);
+    }
+    // The broadcast answer came from a light with known groups or from gear
+    // the driver does not track
+    uint64_t no = _light_addrs & ~known;
+    return narrow_answering(opcode, known, true, members, no);
+}
+
+uint64_t DALIDriver::narrow_answering(uint8_t opcode, uint64_t set,
+                                      bool asked, const uint64_t *members,
+                                      uint64_t &no)
+{
+    int size = 0;
+    for (uint64_t m = set; m; m &= m - 1) {
+        size++;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    if (size == 1) {
+        if (query_any(__builtin_ctzll(set), opcode)) {
+            return set;
+        }
+        no |= set;
+        return 0;
+    }
+    // Group splitting set closest to half, its members outside set must be
+    // known not to answer
+    int best = -1;
+    int best_diff = size;
+    bool covers = false;
+    for (int g = 0; g < 16; g++) {
+        if (!members[g] || (members[g] & ~(set | no))) {
+            continue;
+        }
+        int count = 0;
+        for (uint64_t m = members[g] & set; m; m &= m - 1) {
+            count++;
+        }
+        if (count == size && !asked) {
+            // One frame clears the whole set when nothing answers
+            covers = true;
+            best = g;
+            break;
+        }
+        int diff = count * 2 > size ? count * 2 - size : size - count * 2;
+        if (count > 0 && count < size && diff < best_diff) {
+            best = g;
+            best_diff = diff;
+        }
+    }
+    if (best < 0) {
+        // No group left to split with, ask every light
+        uint64_t yes = 0;
+        for (int addr = 0; addr < 64; addr++) {
+            uint64_t bit = (uint64_t)1 << addr;
+            if (!(set & bit)) {
+                continue;
+            }
+            if (query_any(addr, opcode)) {
+                yes |= bit;
+            } else {
+                no |= bit;
+            }
+        }
+        return yes;
+    }
+    uint64_t half = members[best] & set;
+    if (covers) {
+        if (!query_any(get_group_addr(best), opcode)) {
+            no |= set;
+            return 0;
+        }
+        return narrow_answering(opcode, set, true, members, no);
+    }
+    if (query_any(get_group_addr(best), opcode)) {
+        uint64_t yes = narrow_answering(opcode, half, true, members, no);
+        return yes |
+               narrow_answering(opcode, set & ~half, false, members, no);
+    }
+    no |= half;
+    return narrow_answering(opcode, set & ~half, asked, members, no);
+}
+
+uint64_t DALIDriver::find_lamp_failures()
+{
+    return find_answering(QUERY_LAMP_FAILURE);
+}
+
 ColorType DALIDriver::get_color_type(uint8_t addr) {
     uint8_t channels = query_rgbwaf_channels(addr);
     if (channels == 4) {
@@ -110,6 +729,7 @@ ColorType DALIDriver::get_color_type(uint8_t addr) {
 
 uint8_t DALIDriver::query_color_type_features(uint8_t addr)
 {
+    ApiScope scope(this, API_QUERY_COLOR_TYPE_FEATURES);
     encoder.set_recv_frame_length(8);
     //send command to enable device type 8
     send_command_special(ENABLE_DEVICE_TYPE, 0x08);
@@ -130,11 +750,64 @@ bool DALIDriver::query_temperature_capable(uint8_t addr)
     return (resp & 0x02) >> 1;
 }    
 
+bool DALIDriver::query_xy_capable(uint8_t addr)
+{
+    uint8_t resp = query_color_type_features(addr);
+    return resp & 0x01;
+}
 
-void DALIDriver::set_color_temp(uint8_t addr, uint16_t temp)
+int DALIDriver::query_color_value(uint8_t addr, uint8_t selector)
+{
+    send_command_special(DTR0, selector);
+    send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+    send_command_standard(addr, QUERY_COLOR_VALUE);
+    // The answer is the MSB, the gear puts the LSB in DTR0
+    int msb = encoder.recv();
+    if (msb < 0) {
+        return -1;
+    }
+    send_command_standard(addr, QUERY_CONTENT_DTR0);
+    int lsb = encoder.recv();
+    if (lsb < 0) {
+        return -1;
+    }
+    return (msb << 8) | lsb;
+}
+
+bool DALIDriver::query_tc_limits(uint8_t addr, uint16_t &coolest,
+                                 uint16_t &warmest)
+{
+    ApiScope scope(this, API_QUERY_TC_LIMITS);
+    int cool = query_color_value(addr, COLOR_VALUE_TC_PHYS_COOLEST);
+    int warm = query_color_value(addr, COLOR_VALUE_TC_PHYS_WARMEST);
+    // 0xFFFF is MASK, the gear does not know the limit
+    if (cool < 0 || warm < 0 || cool == 0xFFFF || warm == 0xFFFF ||
+        cool > warm) {
+        return false;
+    }
+    coolest = cool;
+    warmest = warm;
+    if (addr < 64) {
+        _tc_coolest[addr] = coolest;
+        _tc_warmest[addr] = warmest;
+    }
+    return true;
+}
+
+
+uint16_t DALIDriver::temp_to_mirek(uint8_t addr, uint16_t temp)
 {
     // Calculate Mirek from Kelvin
-    temp = 1000000/temp;
+    uint16_t mirek = color_kelvin_to_mirek(temp);
+    if (addr < 64 && _tc_coolest[addr]) {
+        mirek = color_clamp_mirek(mirek, _tc_coolest[addr], _tc_warmest[addr]);
+    }
+    return mirek;
+}
+
+void DALIDriver::set_color_temp(uint8_t addr, uint16_t temp)
+{
+    temp = temp_to_mirek(addr, temp);
     // Set Temp
     send_command_special(DTR0, temp & 0x00FF);
     send_command_special(DTR1, temp >> 8);
@@ -146,18 +819,81 @@ void DALIDriver::set_color_temp(uint8_t addr, uint16_t temp)
 
 void DALIDriver::set_color_scene(uint8_t addr, uint8_t scene, uint16_t temp)
 {
+    ApiScope scope(this, API_SET_COLOR_SCENE);
     set_color_temp(addr, temp);    
     // Get the current scene level
-    send_command_standard(addr, QUERY_SCENE_LEVEL + scene);
-    uint8_t scene_level = encoder.recv();
+    uint8_t scene_level = query_scene_level(addr, scene);
     send_command_special(DTR0, scene_level);
 
     // Store what is in the temperorary color as scene color and also scene level to DTR0
     send_twice(addr, STORE_DTR_AS_SCENE + scene);
+    if (_scene_cache) {
+        scene_entry entry;
+        entry.level = scene_level;
+        entry.color_type = SCENE_COLOR_TEMPERATURE;
+        uint16_t mirek = temp_to_mirek(addr, temp);
+        entry.color[0] = mirek & 0x00FF;
+        entry.color[1] = mirek >> 8;
+        entry.color[2] = 0;
+        entry.color[3] = 0;
+        _scene_cache->set(addr, scene, entry);
+    }
+}
+
+void DALIDriver::set_color_xy(uint8_t addr, uint16_t x, uint16_t y)
+{
+    ApiScope scope(this, API_SET_COLOR_XY);
+    set_color_xy_temp(addr, x, y);
+    send_activate(addr);
+}
+
+void DALIDriver::set_color_xy_temp(uint8_t addr, uint16_t x, uint16_t y)
+{
+    send_command_special(DTR0, x & 0x00FF);
+    send_command_special(DTR1, x >> 8);
+    send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+    send_command_standard(addr, SET_TEMP_X_COORD);
+    send_command_special(DTR0, y & 0x00FF);
+    send_command_special(DTR1, y >> 8);
+    send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+    send_command_standard(addr, SET_TEMP_Y_COORD);
+}
+
+void DALIDriver::send_activate(uint8_t addr)
+{
+    //send command to enable device type 8
+    send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+    send_command_standard(addr, COLOR_ACTIVATE);
+}
+
+void DALIDriver::stage_color(uint8_t addr, uint16_t temp)
+{
+    ApiScope scope(this, API_STAGE_COLOR);
+    set_color_temp(addr, temp);
+}
+
+void DALIDriver::stage_color(uint8_t addr, uint8_t r, uint8_t g, uint8_t b,
+                             uint8_t dim)
+{
+    ApiScope scope(this, API_STAGE_COLOR);
+    set_color_temp(addr, r, g, b, dim);
+}
+
+void DALIDriver::stage_color_xy(uint8_t addr, uint16_t x, uint16_t y)
+{
+    ApiScope scope(this, API_STAGE_COLOR);
+    set_color_xy_temp(addr, x, y);
+}
+
+void DALIDriver::activate_color(uint8_t addr)
+{
+    ApiScope scope(this, API_ACTIVATE_COLOR);
+    send_activate(addr);
 }
 
 void DALIDriver::set_color(uint8_t addr, uint16_t temp)
 {
+    ApiScope scope(this, API_SET_COLOR);
     set_color_temp(addr, temp);    
     // Activate color
     //send command to enable device type 8
@@ -167,40 +903,136 @@ void DALIDriver::set_color(uint8_t addr, uint16_t temp)
 
 void DALIDriver::set_color_temp(uint8_t addr, uint8_t r, uint8_t g, uint8_t b, uint8_t dim)
 {
-    // Set RGB
-    send_command_special(DTR0, r);
-    send_command_special(DTR1, g);
-    send_command_special(DTR2, b);
-    //send command to enable device type 8
-    send_command_special(ENABLE_DEVICE_TYPE, 0x08);
-    send_command_standard(addr, SET_TEMP_RGB_DIM); 
-    
-    // Set dim
-    send_command_special(DTR0, dim);
-    //send command to enable device type 8
-    send_command_special(ENABLE_DEVICE_TYPE, 0x08);
-    send_command_standard(addr, SET_TEMP_WAF_DIM); 
+    // Dim is the white channel, amber and freecolour are left alone
+    uint8_t levels[6] = {r, g, b, dim, DALI_MASK, DALI_MASK};
+    stage_rgbwaf(&addr, 1, levels,
+                 CHANNEL_RED | CHANNEL_GREEN | CHANNEL_BLUE | CHANNEL_WHITE);
+}
+
+void DALIDriver::stage_rgbwaf(const uint8_t *addrs, uint8_t n,
+                              const uint8_t *levels, uint8_t mask)
+{
+    // DTR values loaded by this call, the SET_TEMP commands leave them alone
+    int dtr[3] = {-1, -1, -1};
+    static const uint8_t dtr_addr[3] = {DTR0, DTR1, DTR2};
+    static const uint8_t set_temp[2] = {SET_TEMP_RGB_DIM, SET_TEMP_WAF_DIM};
+    for (int triplet = 0; triplet < 2; triplet++) {
+        if (!((mask >> (triplet * 3)) & 0x07)) {
+            continue;
+        }
+        for (int i = 0; i < 3; i++) {
+            int channel = triplet * 3 + i;
+            uint8_t value = (mask & (1 << channel)) ? levels[channel]
+                                                    : DALI_MASK;
+            if (dtr[i] != value) {
+                send_command_special(dtr_addr[i], value);
+                dtr[i] = value;
+            }
+        }
+        for (int a = 0; a < n; a++) {
+            //send command to enable device type 8
+            send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+            send_command_standard(addrs[a], set_temp[triplet]);
+        }
+    }
+}
+
+void DALIDriver::forget_rgbwaf(uint8_t addr)
+{
+    if (addr < 64) {
+        memset(_rgbwaf[addr], DALI_MASK, sizeof(_rgbwaf[addr]));
+        return;
+    }
+    // Lights in the group, or that may be in it
+    for (int light = 0; light < 64; light++) {
+        uint64_t bit = (uint64_t)1 << light;
+        if ((addr & 0xF0) != 0x80 || !(_groups_known & bit) ||
+            ((_groups[light] >> (addr & 0x0F)) & 1)) {
+            memset(_rgbwaf[light], DALI_MASK, sizeof(_rgbwaf[light]));
+        }
+    }
+}
+
+void DALIDriver::send_rgbwaf(const uint8_t *addrs, uint8_t n,
+                             const uint8_t *levels, uint8_t mask, bool force)
+{
+    // Drop the channels every light already has
+    for (int channel = 0; channel < 6 && !force; channel++) {
+        if (!(mask & (1 << channel))) {
+            continue;
+        }
+        bool changed = false;
+        for (int a = 0; a < n && !changed; a++) {
+            changed = addrs[a] >= 64 || _rgbwaf[addrs[a]][channel] == DALI_MASK ||
+                      _rgbwaf[addrs[a]][channel] != levels[channel];
+        }
+        if (!changed) {
+            mask &= ~(1 << channel);
+        }
+    }
+    if (!mask) {
+        return;
+    }
+    // Addresses are sent as given: a group or broadcast frame also reaches
+    // gear the driver does not track, see stage_color for group activation
+    stage_rgbwaf(addrs, n, levels, mask);
+    for (int a = 0; a < n; a++) {
+        //send command to enable device type 8
+        send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+        send_command_standard(addrs[a], COLOR_ACTIVATE);
+    }
+    for (int a = 0; a < n; a++) {
+        if (addrs[a] >= 64) {
+            // Group membership is not known
+            forget_rgbwaf(addrs[a]);
+            continue;
+        }
+        for (int channel = 0; channel < 6; channel++) {
+            if (mask & (1 << channel)) {
+                _rgbwaf[addrs[a]][channel] = levels[channel];
+            }
+        }
+    }
+}
+
+void DALIDriver::set_rgbwaf(const uint8_t *addrs, uint8_t n,
+                            const uint8_t *levels, uint8_t mask, bool force)
+{
+    ApiScope scope(this, API_SET_RGBWAF);
+    send_rgbwaf(addrs, n, levels, mask & CHANNEL_ALL, force);
+}
+
+void DALIDriver::set_rgbwaf(uint8_t addr, const uint8_t *levels,
+                            uint8_t mask, bool force)
+{
+    set_rgbwaf(&addr, 1, levels, mask, force);
 }
     
 void DALIDriver::set_color_scene(uint8_t addr, uint8_t scene, uint8_t r, uint8_t g, uint8_t b, uint8_t dim)
 {
+    ApiScope scope(this, API_SET_COLOR_SCENE);
     set_color_temp(addr, r, g, b, dim);
     // Get the current scene level
-    send_command_standard(addr, QUERY_SCENE_LEVEL + scene);
-    uint8_t scene_level = encoder.recv();
+    uint8_t scene_level = query_scene_level(addr, scene);
     send_command_special(DTR0, scene_level);
 
     // Store what is in the temperorary color as scene color and also scene level to DTR0
     send_twice(addr, STORE_DTR_AS_SCENE + scene);
+    if (_scene_cache) {
+        scene_entry entry = {scene_level, SCENE_COLOR_RGB, {r, g, b, dim}};
+        _scene_cache->set(addr, scene, entry);
+    }
 }
     
 void DALIDriver::set_color(uint8_t addr, uint8_t r, uint8_t g, uint8_t b, uint8_t dim)
 {
-    set_color_temp(addr, r, g, b, dim);
-    // Activate color
-    //send command to enable device type 8
-    send_command_special(ENABLE_DEVICE_TYPE, 0x08);
-    send_command_standard(addr, COLOR_ACTIVATE); 
+    ApiScope scope(this, API_SET_COLOR);
+    // Dim is the white channel, amber and freecolour are left alone
+    uint8_t levels[6] = {r, g, b, dim, DALI_MASK, DALI_MASK};
+    // Always sent, the colour may have been changed by another master
+    send_rgbwaf(&addr, 1, levels,
+                CHANNEL_RED | CHANNEL_GREEN | CHANNEL_BLUE | CHANNEL_WHITE,
+                true);
 }
     
 
@@ -211,51 +1043,436 @@ uint32_t DALIDriver::recv()
 
 uint32_t DALIDriver::query_instances(uint8_t addr)
 {
+    ApiScope scope(this, API_QUERY_INSTANCES);
     encoder.set_recv_frame_length(8);
     send_command_standard_input(addr, 0xFE, 0x35);
     uint32_t resp = encoder.recv();
     return resp;
 }
 
-void DALIDriver::turn_on(uint8_t addr)
+void DALIDriver::turn_on(uint8_t addr)
+{
+    ApiScope scope(this, API_TURN_ON);
+    send_command_standard(addr, ON_AND_STEP_UP);
+}
+
+void DALIDriver::begin_batch()
+{
+    _batch_depth++;
+}
+
+void DALIDriver::end_batch()
+{
+    ApiScope scope(this, API_END_BATCH);
+    if (_batch_depth && --_batch_depth == 0) {
+        flush_batch();
+    }
+}
+
+void DALIDriver::send_with_dtr0(uint8_t addr, uint8_t opcode, uint8_t value)
+{
+    if (!_batch_depth) {
+        send_command_special(DTR0, value);
+        send_twice(addr, opcode);
+        return;
+    }
+    bool min_max = opcode == SET_MIN_LEVEL || opcode == SET_MAX_LEVEL;
+    for (int i = 0; i < _batch_count; i++) {
+        batch_command &queued = _batch[i];
+        // Short addresses only overlap themselves, a group may hold anything
+        bool overlap =
+            queued.addr == addr || queued.addr >= 64 || addr >= 64;
+        if (queued.addr == addr && queued.opcode == opcode) {
+            queued.value = value;
+            return;
+        }
+        // The order of these matters, so the earlier one goes first
+        if (overlap &&
+            (queued.opcode == opcode ||
+             (min_max && (queued.opcode == SET_MIN_LEVEL ||
+                          queued.opcode == SET_MAX_LEVEL)))) {
+            flush_batch();
+            break;
+        }
+    }
+    if (_batch_count == BATCH_MAX_COMMANDS) {
+        flush_batch();
+    }
+    batch_command &command = _batch[_batch_count++];
+    command.addr = addr;
+    command.opcode = opcode;
+    command.value = value;
+}
+
+void DALIDriver::flush_batch()
+{
+    // Emptied first, the frames below would flush it again
+    uint8_t count = _batch_count;
+    _batch_count = 0;
+    bool sent[BATCH_MAX_COMMANDS];
+    memset(sent, 0, sizeof(sent));
+    for (int i = 0; i < count; i++) {
+        if (sent[i]) {
+            continue;
+        }
+        send_command_special(DTR0, _batch[i].value);
+        for (int j = i; j < count; j++) {
+            if (!sent[j] && _batch[j].value == _batch[i].value) {
+                send_twice(_batch[j].addr, _batch[j].opcode);
+                sent[j] = true;
+            }
+        }
+    }
+}
+
+void DALIDriver::send_twice(uint8_t addr, uint8_t opcode)
+{
+    send_command_standard(addr, opcode);
+    send_command_standard(addr, opcode);
+}
+
+void DALIDriver::set_fade_time(uint8_t addr, uint8_t time)
+{
+    ApiScope scope(this, API_SET_FADE_TIME);
+    set_config_value(addr, CONFIG_FADE_TIME, time);
+}
+
+void DALIDriver::set_fade_rate(uint8_t addr, uint8_t rate)
+{
+    ApiScope scope(this, API_SET_FADE_RATE);
+    set_config_value(addr, CONFIG_FADE_RATE, rate);
+}
+
+void DALIDriver::set_min_level(uint8_t addr, uint8_t level)
+{
+    ApiScope scope(this, API_SET_MIN_LEVEL);
+    set_config_value(addr, CONFIG_MIN_LEVEL, level);
+}
+
+void DALIDriver::set_max_level(uint8_t addr, uint8_t level)
+{
+    ApiScope scope(this, API_SET_MAX_LEVEL);
+    set_config_value(addr, CONFIG_MAX_LEVEL, level);
+}
+
+void DALIDriver::set_power_on_level(uint8_t addr, uint8_t level)
+{
+    ApiScope scope(this, API_SET_POWER_ON_LEVEL);
+    set_config_value(addr, CONFIG_POWER_ON_LEVEL, level);
+}
+
+void DALIDriver::set_system_failure_level(uint8_t addr, uint8_t level)
+{
+    ApiScope scope(this, API_SET_SYSTEM_FAILURE_LEVEL);
+    set_config_value(addr, CONFIG_FAILURE_LEVEL, level);
+}
+
+void DALIDriver::set_config_value(uint8_t addr, ConfigField field,
+                                  uint8_t value)
+{
+    uint8_t opcode;
+    switch (field) {
+        case CONFIG_FADE_TIME:
+            opcode = SET_FADE_TIME;
+            break;
+        case CONFIG_FADE_RATE:
+            opcode = SET_FADE_RATE;
+            break;
+        case CONFIG_MIN_LEVEL:
+            opcode = SET_MIN_LEVEL;
+            break;
+        case CONFIG_MAX_LEVEL:
+            opcode = SET_MAX_LEVEL;
+            break;
+        case CONFIG_POWER_ON_LEVEL:
+            opcode = SET_POWER_ON_LEVEL;
+            break;
+        default:
+            opcode = SET_SYSTEM_FAILURE_LEVEL;
+            break;
+    }
+    send_with_dtr0(addr, opcode, value);
+    if (addr >= 64) {
+        // The members of a group are not known here
+        _config_known = 0;
+        return;
+    }
+    // Cache what the gear keeps, it clamps the levels to each other
+    gear_config &config = _config[addr];
+    switch (field) {
+        case CONFIG_FADE_TIME:
+            config.fade_time = value > 15 ? 15 : value;
+            break;
+        case CONFIG_FADE_RATE:
+            if (value == 0) {
+                // Not a valid rate, gear differ in what they do with it
+                _config_known &= ~((uint64_t)1 << addr);
+            }
+            config.fade_rate = value > 15 ? 15 : value;
+            break;
+        case CONFIG_MIN_LEVEL:
+            value = value < _phm[addr] ? _phm[addr] : value;
+            config.min_level =
+                value > config.max_level ? config.max_level : value;
+            break;
+        case CONFIG_MAX_LEVEL:
+            value = value < config.min_level ? config.min_level : value;
+            config.max_level = value > 254 ? 254 : value;
+            break;
+        case CONFIG_POWER_ON_LEVEL:
+            config.power_on_level = value;
+            break;
+        default:
+            config.failure_level = value;
+            break;
+    }
+}
+
+bool DALIDriver::read_config(uint8_t addr)
+{
+    ApiScope scope(this, API_READ_CONFIG);
+    if (addr >= 64) {
+        return false;
+    }
+    static const uint8_t queries[5] = {QUERY_FADE, QUERY_MIN_LEVEL,
+                                       QUERY_MAX_LEVEL, QUERY_POWER_ON_LEVEL,
+                                       QUERY_SYSTEM_FAILURE_LEVEL};
+    uint64_t bit = (uint64_t)1 << addr;
+    _config_known &= ~bit;
+    if (!_phm[addr]) {
+        // Fixed by the gear, read once
+        send_command_standard(addr, QUERY_PHM);
+        int resp = encoder.recv();
+        if (resp < 0) {
+            return false;
+        }
+        _phm[addr] = resp ? resp : 1;
+    }
+    uint8_t answers[5];
+    for (int i = 0; i < 5; i++) {
+        send_command_standard(addr, queries[i]);
+        int resp = encoder.recv();
+        if (resp < 0) {
+            return false;
+        }
+        answers[i] = resp;
+    }
+    gear_config &config = _config[addr];
+    config.fade_time = answers[0] >> 4;
+    config.fade_rate = answers[0] & 0x0F;
+    config.min_level = answers[1];
+    config.max_level = answers[2];
+    config.power_on_level = answers[3];
+    config.failure_level = answers[4];
+    _config_known |= bit;
+    return true;
+}
+
+bool DALIDriver::get_config(uint8_t addr, gear_config &config)
+{
+    if (addr >= 64) {
+        return false;
+    }
+    if (!(_config_known & ((uint64_t)1 << addr)) && !read_config(addr)) {
+        return false;
+    }
+    config = _config[addr];
+    return true;
+}
+
+// Parameter of a configuration by ConfigField bit number
+static uint8_t config_value(const gear_config &config, int field)
+{
+    switch (field) {
+        case 0:
+            return config.fade_time;
+        case 1:
+            return config.fade_rate;
+        case 2:
+            return config.min_level;
+        case 3:
+            return config.max_level;
+        case 4:
+            return config.power_on_level;
+        default:
+            return config.failure_level;
+    }
+}
+
+void DALIDriver::normalise_config(uint8_t addr, gear_config &config)
+{
+    uint8_t phm = _phm[addr] ? _phm[addr] : 1;
+    if (config.fade_time > 15) {
+        config.fade_time = 15;
+    }
+    if (config.fade_rate == 0) {
+        config.fade_rate = 1;
+    } else if (config.fade_rate > 15) {
+        config.fade_rate = 15;
+    }
+    // The maximum wins when the two levels cross
+    if (config.max_level > 254) {
+        config.max_level = 254;
+    } else if (config.max_level < phm) {
+        config.max_level = phm;
+    }
+    if (config.min_level < phm) {
+        config.min_level = phm;
+    } else if (config.min_level > config.max_level) {
+        config.min_level = config.max_level;
+    }
+}
+
+int DALIDriver::apply_config(const uint8_t *addrs, const gear_config *configs,
+                             uint8_t n, uint8_t fields)
+{
+    ApiScope scope(this, API_APPLY_CONFIG);
+    // ConfigField bits to write per device, in three batches: the gear
+    // clamps the minimum to the maximum and the other way round, so a new
+    // minimum above the current maximum waits until the maximum is raised
+    uint8_t pending[3][64];
+    gear_config desired[64];
+    memset(pending, 0, sizeof(pending));
+    for (int i = 0; i < n; i++) {
+        uint8_t addr = addrs[i];
+        if (addr >= 64 || !read_config(addr)) {
+            continue;
+        }
+        const gear_config &current = _config[addr];
+        // Compare with what the gear would keep, or it never settles
+        gear_config &want = desired[addr];
+        want = configs[i];
+        normalise_config(addr, want);
+        uint8_t diff = 0;
+        for (int field = 0; field < 6; field++) {
+            if (config_value(current, field) != config_value(want, field)) {
+                diff |= 1 << field;
+            }
+        }
+        diff &= fields;
+        pending[1][addr] = diff & CONFIG_MAX_LEVEL;
+        if ((diff & CONFIG_MIN_LEVEL) && want.min_level > current.max_level) {
+            pending[2][addr] = CONFIG_MIN_LEVEL;
+            diff &= ~CONFIG_MIN_LEVEL;
+        }
+        pending[0][addr] = diff & ~CONFIG_MAX_LEVEL;
+    }
+
+    int writes = 0;
+    for (int pass = 0; pass < 3; pass++) {
+        begin_batch();
+        for (int addr = 0; addr < 64; addr++) {
+            for (int field = 0; field < 6; field++) {
+                if (pending[pass][addr] & (1 << field)) {
+                    set_config_value(addr, (ConfigField)(1 << field),
+                                     config_value(desired[addr], field));
+                    writes++;
+                }
+            }
+        }
+        end_batch();
+    }
+    return writes;
+}
+
+void DALIDriver::set_scene(uint8_t addr, uint8_t scene, uint8_t level)
+{
+    ApiScope scope(this, API_SET_SCENE);
+    send_with_dtr0(addr, SET_SCENE + scene, level);
+    if (_scene_cache) {
+        _scene_cache->set_level(addr, scene, level);
+    }
+}
+
+void DALIDriver::remove_from_scene(uint8_t addr, uint8_t scene)
 {
-    send_command_standard(addr, ON_AND_STEP_UP);
+    ApiScope scope(this, API_REMOVE_FROM_SCENE);
+    send_twice(addr, REMOVE_FROM_SCENE + scene);
+    if (_scene_cache) {
+        _scene_cache->set_level(addr, scene, DALI_MASK);
+    }
 }
 
-void DALIDriver::send_twice(uint8_t addr, uint8_t opcode)
+void DALIDriver::capture_scene(uint8_t addr, uint8_t scene)
 {
-    send_command_standard(addr, opcode);
-    send_command_standard(addr, opcode);
+    ApiScope scope(this, API_CAPTURE_SCENE);
+    // Send twice command
+    send_twice(addr, STORE_ACTUAL_LEVEL_IN_DTR0);
+    // DT8 lights put their actual colour in the temporary colour, other
+    // gear ignores the command
+    send_command_special(ENABLE_DEVICE_TYPE, 0x08);
+    send_command_standard(addr, COPY_REPORT_TO_TEMP);
+    // Store DTR0 and the temporary colour as the scene
+    send_twice(addr, SET_SCENE + scene);
+    // Every light stored its own values, the cache cannot know them
+    if (_scene_cache) {
+        _scene_cache->forget(addr, scene);
+    }
 }
 
-void DALIDriver::set_fade_time(uint8_t addr, uint8_t time)
+int DALIDriver::query_scene_level(uint8_t addr, uint8_t scene)
 {
-    // Send twice command
-    send_command_special(DTR0, time);
-    send_twice(addr, SET_FADE_TIME);
+    if (_scene_cache && _scene_cache->known(addr, scene)) {
+        return _scene_cache->get(addr, scene).level;
+    }
+    send_command_standard(addr, QUERY_SCENE_LEVEL + scene);
+    int level = encoder.recv();
+    if (level >= 0 && _scene_cache && addr < SCENE_CACHE_ADDRS) {
+        _scene_cache->set_level(addr, scene, level);
+    }
+    return level;
 }
 
-void DALIDriver::set_fade_rate(uint8_t addr, uint8_t rate)
+int DALIDriver::read_scenes(const uint8_t *addrs, uint8_t n)
 {
-    // Send twice command
-    send_command_special(DTR0, rate);
-    send_twice(addr, SET_FADE_RATE);
+    ApiScope scope(this, API_READ_SCENES);
+    if (!_scene_cache) {
+        return -1;
+    }
+    int read = 0;
+    for (int a = 0; a < n; a++) {
+        if (addrs[a] >= SCENE_CACHE_ADDRS) {
+            continue;
+        }
+        for (uint8_t scene = 0; scene < SCENE_COUNT; scene++) {
+            send_command_standard(addrs[a], QUERY_SCENE_LEVEL + scene);
+            int level = encoder.recv();
+            if (level < 0) {
+                // Not on the bus, do not wait for the other 15
+                if (scene == 0) {
+                    break;
+                }
+                _scene_cache->forget(addrs[a], scene);
+                continue;
+            }
+            // Keep a colour the driver wrote, the gear cannot report it
+            if (_scene_cache->known(addrs[a], scene) &&
+                _scene_cache->get(addrs[a], scene).level == level) {
+                read++;
+                continue;
+            }
+            _scene_cache->set_level(addrs[a], scene, level);
+            read++;
+        }
+    }
+    return read;
 }
 
-void DALIDriver::set_scene(uint8_t addr, uint8_t scene, uint8_t level)
+uint8_t DALIDriver::get_scene_level(uint8_t addr, uint8_t scene)
 {
-    send_command_special(DTR0, level);
-    // Send twice command
-    send_twice(addr, SET_SCENE + scene);
+    ApiScope scope(this, API_GET_SCENE_LEVEL);
+    int level = query_scene_level(addr, scene);
+    return level < 0 ? DALI_MASK : level;
 }
 
-void DALIDriver::remove_from_scene(uint8_t addr, uint8_t scene)
+void DALIDriver::set_scene_cache(DALISceneCache *cache)
 {
-    send_twice(addr, REMOVE_FROM_SCENE + scene);
+    _scene_cache = cache;
 }
 
 void DALIDriver::go_to_scene(uint8_t addr, uint8_t scene)
 {
+    ApiScope scope(this, API_GO_TO_SCENE);
     send_twice(addr, GO_TO_SCENE + scene);
     //send command to enable device type 8
     send_command_special(ENABLE_DEVICE_TYPE, 0x08);
@@ -292,11 +1509,19 @@ void DALIDriver::reattach()
 
 void DALIDriver::send_command_special(uint8_t address, uint8_t opcode)
 {
+    if (_batch_count) {
+        flush_batch();
+    }
+    _stats.special_frames++;
     encoder.send(((uint16_t)address << 8) | opcode);
 }
 
 void DALIDriver::send_command_special_input(uint8_t instance, uint8_t opcode)
 {
+    if (_batch_count) {
+        flush_batch();
+    }
+    _stats.input_special_frames++;
     encoder.send_24(((uint32_t)0xC1 << 16) | ((uint16_t)instance << 8) |
                     opcode);
 }
@@ -304,6 +1529,10 @@ void DALIDriver::send_command_special_input(uint8_t instance, uint8_t opcode)
 void DALIDriver::send_command_standard_input(uint8_t address, uint8_t instance,
                                              uint8_t opcode)
 {
+    if (_batch_count) {
+        flush_batch();
+    }
+    _stats.input_standard_frames++;
     // Get the upper bit
     uint8_t mask = address & 0x80;
     // Change address to have 1 in LSb to signify 'standard command'
@@ -314,6 +1543,18 @@ void DALIDriver::send_command_standard_input(uint8_t address, uint8_t instance,
 
 void DALIDriver::send_command_standard(uint8_t address, uint8_t opcode)
 {
+    if (_batch_count) {
+        flush_batch();
+    }
+    // Commands below 0x20 change the arc power
+    if (opcode < 0x20) {
+        level_override(address);
+    }
+    // Colour activation and scene recalls change the colour channels
+    if (opcode == COLOR_ACTIVATE || (opcode & 0xF0) == GO_TO_SCENE) {
+        forget_rgbwaf(address);
+    }
+    _stats.standard_frames++;
     // Get the upper bit
     uint8_t mask = address & 0x80;
     // Change address to have 1 in LSb to signify 'standard command'
@@ -323,6 +1564,16 @@ void DALIDriver::send_command_standard(uint8_t address, uint8_t opcode)
 
 void DALIDriver::send_command_direct(uint8_t address, uint8_t opcode)
 {
+    level_override(address);
+    send_direct(address, opcode);
+}
+
+void DALIDriver::send_direct(uint8_t address, uint8_t opcode)
+{
+    if (_batch_count) {
+        flush_batch();
+    }
+    _stats.direct_frames++;
     // Get the upper bit
     uint8_t mask = address & 0x80;
     // Change address to have 0 in LSb to signify 'direct arc power'
@@ -378,6 +1629,7 @@ void DALIDriver::quiet_mode(bool on)
 
 float DALIDriver::get_temperature(uint8_t addr, uint8_t instance)
 {
+    ApiScope scope(this, API_GET_TEMPERATURE);
     send_command_standard_input(addr, instance, 0x8C);
     int temp = encoder.recv();
     send_command_standard_input(addr, instance, 0x8D);
@@ -389,6 +1641,7 @@ float DALIDriver::get_temperature(uint8_t addr, uint8_t instance)
 
 float DALIDriver::get_humidity(uint8_t addr, uint8_t instance)
 {
+    ApiScope scope(this, API_GET_HUMIDITY);
     send_command_standard_input(addr, instance, 0x8C);
     int humidity = encoder.recv();
     // Humidity, 8 bit, resolution 0.5%, 0-100%
@@ -397,6 +1650,7 @@ float DALIDriver::get_humidity(uint8_t addr, uint8_t instance)
 
 int DALIDriver::init_lights()
 {
+    ApiScope scope(this, API_INIT_LIGHTS);
     quiet_mode(true);
     // TODO: does this need to happen every time controller boots?
     num_lights = assign_addresses();
@@ -405,39 +1659,184 @@ int DALIDriver::init_lights()
 
 int DALIDriver::init_inputs()
 {
+    ApiScope scope(this, API_INIT_INPUTS);
     quiet_mode(true);
+    _input_addrs = 0;
     num_inputs = assign_addresses_input(true, num_lights) - num_lights;
+    // Right above the lights unless the inputs had to wrap around
+    inputs_start = _input_addrs ? __builtin_ctzll(_input_addrs)
+                   : _light_addrs ? 64 - __builtin_clzll(_light_addrs)
+                                  : 0;
     return num_inputs;
 }
 
 int DALIDriver::init()
 {
+    ApiScope scope(this, API_INIT);
     num_logical_units = num_lights + num_inputs;
     init_lights();
     init_inputs();
     // Set the event scheme for all events to be address / instance id / event
     // info
     set_event_scheme(0xFF, 0xFF, 0x01);
-    wait(1);
-    for (int i = num_lights; i < num_inputs + num_lights; i++) {
-        int inst = query_instances(i);
-        for (int j = 0; j < inst; j++) {
-            int inst_type = get_instance_type(i, j);
-            if (inst_type == 4) {
-                // Disable lumen
-                disable_instance(i, j);
-                continue;
-            }
-            enable_instance(i, j);
-            // Filter events for PIR, only movement/no movement
-            if (inst_type == 3) {
-                set_event_filter(i, j, 0x1C);
-            }
+    encoder.idle(1000000);
+    for (int addr = 0; addr < 64; addr++) {
+        if (_input_addrs & ((uint64_t)1 << addr)) {
+            setup_input(addr);
         }
     }
     return num_lights + num_inputs;
 }
 
+void DALIDriver::setup_input(uint8_t addr)
+{
+    int inst = query_instances(addr);
+    for (int j = 0; j < inst; j++) {
+        int inst_type = get_instance_type(addr, j);
+        if (inst_type == 4) {
+            // Disable lumen
+            disable_instance(addr, j);
+            continue;
+        }
+        enable_instance(addr, j);
+        // Filter events for PIR, only movement/no movement
+        if (inst_type == 3) {
+            set_event_filter(addr, j, 0x1C);
+        }
+    }
+}
+
+int DALIDriver::add_new_devices()
+{
+    ApiScope scope(this, API_ADD_NEW_DEVICES);
+    quiet_mode(true);
+    int added = add_new_gear();
+    added += add_new_inputs();
+    quiet_mode(false);
+    return added;
+}
+
+int DALIDriver::lowest_free_address()
+{
+    uint64_t used = _light_addrs | _input_addrs;
+    // Same range as the gear, addresses in the identity map are kept for
+    // the lights they belong to
+    for (int addr = 0; addr < 63; addr++) {
+        if (!(used & ((uint64_t)1 << addr)) &&
+            (!_identity_map || !_identity_map->reserved(addr))) {
+            return addr;
+        }
+    }
+    return -1;
+}
+
+bool DALIDriver::search_lowest(bool input, uint32_t &random_addr)
+{
+    uint32_t searchAddr = 0xFFFFFF;
+    for (int i = 24; i >= 0; i--) {
+        // The first round checks that anything is left at all
+        uint32_t mask = i < 24 ? 1 << i : 0;
+        searchAddr = searchAddr & (~mask);
+        if (input) {
+            set_search_address_input(searchAddr);
+            send_command_special_input(0x03, 0x00);
+        } else {
+            set_search_address(searchAddr);
+            send_command_special(COMPARE, 0x00);
+        }
+        bool yes = check_response(YES);
+        if (!yes) {
+            if (!mask) {
+                return false;
+            }
+            // No unit here, revert the mask
+            searchAddr = searchAddr | mask;
+        }
+    }
+    random_addr = searchAddr;
+    return true;
+}
+
+int DALIDriver::add_new_gear()
+{
+    int added = 0;
+    // Only gear without a short address
+    send_command_special(INITIALISE, 0xFF);
+    send_command_special(INITIALISE, 0xFF);
+    send_command_special(RANDOMISE, 0x00);
+    send_command_special(RANDOMISE, 0x00);
+    encoder.idle(100000);
+    uint32_t random_addr;
+    while (search_lowest(false, random_addr)) {
+        set_search_address(random_addr);
+        int addr = program_found_gear(_light_addrs | _input_addrs);
+        if (addr < 0) {
+            break;
+        }
+        if (!(_light_addrs & ((uint64_t)1 << addr))) {
+            _light_addrs |= (uint64_t)1 << addr;
+            num_lights++;
+        }
+        added++;
+    }
+    send_command_special(TERMINATE, 0x00);
+    return added;
+}
+
+int DALIDriver::add_new_inputs()
+{
+    int added = 0;
+    // Only input devices without a short address
+    send_command_special_input(0x01, 0x7F);
+    send_command_special_input(0x01, 0x7F);
+    send_command_special_input(0x02, 0x00);
+    send_command_special_input(0x02, 0x00);
+    encoder.idle(100000);
+    uint32_t random_addr;
+    uint64_t found = 0;
+    while (search_lowest(true, random_addr)) {
+        int addr = lowest_free_address();
+        if (addr < 0) {
+            break;
+        }
+        set_search_address_input(random_addr);
+        send_command_special_input(0x08, addr);
+        send_command_special_input(0x04, 0x00);
+        _input_addrs |= (uint64_t)1 << addr;
+        found |= (uint64_t)1 << addr;
+        num_inputs++;
+        added++;
+    }
+    send_command_special_input(0x00, 0x00);
+    for (int addr = 0; addr < 64; addr++) {
+        if (found & ((uint64_t)1 << addr)) {
+            set_event_scheme(addr, 0xFF, 0x01);
+            setup_input(addr);
+        }
+    }
+    return added;
+}
+
+void DALIDriver::forget_address(uint8_t addr)
+{
+    if (addr >= 64) {
+        return;
+    }
+    uint64_t bit = (uint64_t)1 << addr;
+    _groups_known &= ~bit;
+    _groups_seen &= ~bit;
+    _config_known &= ~bit;
+    _phm[addr] = 0;
+    _tc_coolest[addr] = 0;
+    _tc_warmest[addr] = 0;
+    memset(_rgbwaf[addr], DALI_MASK, sizeof(_rgbwaf[addr]));
+    _level_sent[addr] = -1;
+    release_level(addr);
+    if (_scene_cache) {
+        _scene_cache->forget_address(addr);
+    }
+}
+
 void DALIDriver::set_event_scheme(uint8_t addr, uint8_t inst, uint8_t scheme)
 {
     // Put scheme in DTR0
@@ -458,11 +1857,13 @@ void DALIDriver::set_event_filter(uint8_t addr, uint8_t inst, uint8_t filter)
 
 uint8_t DALIDriver::get_instance_type(uint8_t addr, uint8_t inst)
 {
+    ApiScope scope(this, API_GET_INSTANCE_TYPE);
     send_command_standard_input(addr, inst, 0x80);
     return encoder.recv();
 }
 uint8_t DALIDriver::get_instance_status(uint8_t addr, uint8_t inst)
 {
+    ApiScope scope(this, API_GET_INSTANCE_STATUS);
     send_command_standard_input(addr, inst, 0x86);
     return encoder.recv();
 }
@@ -479,16 +1880,16 @@ void DALIDriver::enable_instance(uint8_t addr, uint8_t inst)
     send_command_standard_input(addr, inst, 0x62);
 }
 
-int DALIDriver::get_highest_address()
+uint64_t DALIDriver::get_assigned_addresses()
 {
-    int highestAssigned = -1;
+    uint64_t assigned = 0;
     // Start initialization phase
     send_command_special(INITIALISE, 0x00);
     send_command_special(INITIALISE, 0x00);
     // Assign all units a random address
     send_command_special(RANDOMISE, 0x00);
     send_command_special(RANDOMISE, 0x00);
-    wait_ms(100);
+    encoder.idle(100000);
 
     while (true) {
         // Set the search address to the highest range
@@ -524,10 +1925,7 @@ int DALIDriver::get_highest_address()
             send_command_special(QUERY_SHORT_ADDR, 0x00);
             uint8_t short_addr = encoder.recv();
             if (short_addr != 0xFF) {
-                short_addr = short_addr >> 1;
-                if (short_addr > highestAssigned) {
-                    highestAssigned = short_addr;
-                }
+                assigned |= (uint64_t)1 << (short_addr >> 1);
             }
             // Tell unit to withdraw (no longer respond to search queries)
             send_command_special(WITHDRAW, 0x00);
@@ -538,25 +1936,20 @@ int DALIDriver::get_highest_address()
     }
 
     send_command_special(TERMINATE, 0x00);
-    return highestAssigned;
+    return assigned;
 }
 
 // Return number of logical units on the bus
 int DALIDriver::assign_addresses(bool reset)
 {
+    ApiScope scope(this, API_ASSIGN_ADDRESSES);
     uint8_t numAssignedShortAddresses = 0;
-    int assignedAddresses[63] = {false};
-    int highestAssigned = -1;
+    uint64_t assigned = 0;
 
     if (!reset) {
-        // Get the highest address already assigned
-        int highest_addr = get_highest_address();
-        if (highest_addr >= 0) {
-            numAssignedShortAddresses = highest_addr + 1;
-            for (int i = 0; i < numAssignedShortAddresses; i++) {
-                assignedAddresses[i] = true;
-            }
-        }
+        // Only the addresses gear answered with, holes stay free
+        assigned = get_assigned_addresses();
+        numAssignedShortAddresses = __builtin_popcountll(assigned);
     }
     // Start initialization phase for devices w/o a short address
     uint8_t opcode = reset ? 0x00 : 0xFF;
@@ -565,7 +1958,7 @@ int DALIDriver::assign_addresses(bool reset)
     // Assign all units a random address
     send_command_special(RANDOMISE, 0x00);
     send_command_special(RANDOMISE, 0x00);
-    wait_ms(100);
+    encoder.idle(100000);
 
     while (true) {
         // Set the search address to the highest range
@@ -599,46 +1992,485 @@ int DALIDriver::assign_addresses(bool reset)
             bool yes = check_response(YES);
             if (yes) {
                 // We found a unit, let's program the short address with a new
-                // address Give it a temporary short address
-                uint8_t new_addr = numAssignedShortAddresses;
-                if (new_addr < 63) {
-                    if (assignedAddresses[new_addr] == true) {
-                        // Duplicate addr?
-                    } else {
-                        // Program new address as short address
-                        send_command_special(PROGRAM_SHORT_ADDR,
-                                             (new_addr << 1) + 1);
-                        // Tell unit to withdraw (no longer respond to search
-                        // queries)
-                        send_command_special(WITHDRAW, 0x00);
-                        numAssignedShortAddresses++;
-                        assignedAddresses[new_addr] = true;
-                        if (new_addr > highestAssigned)
-                            highestAssigned = new_addr;
-                    }
-                } else {
-                    // expected < 63 ?
+                // address and tell it to withdraw
+                int new_addr = program_found_gear(assigned);
+                if (new_addr >= 0) {
+                    numAssignedShortAddresses++;
+                    assigned |= (uint64_t)1 << new_addr;
                 }
             } else {
                 // No device found
             }
+        } else {
+            // No short address left for the devices still searching
+            break;
         }
-        // Refresh initialization state
-        send_command_special(INITIALISE, 0x00);
-        send_command_special(INITIALISE, 0x00);
+        // Refresh initialization state, gear that kept its address stays out
+        send_command_special(INITIALISE, opcode);
+        send_command_special(INITIALISE, opcode);
     }
 
     send_command_special(TERMINATE, 0x00);
+    _light_addrs = assigned;
     return numAssignedShortAddresses;
 }
 
+int DALIDriver::program_found_gear(uint64_t used)
+{
+    // Lowest free address, leaving the addresses of devices in the identity
+    // map to them while possible
+    int addr = -1;
+    for (int pass = 0; pass < 2 && addr < 0; pass++) {
+        for (int a = 0; a < 63; a++) {
+            if (!(used & ((uint64_t)1 << a)) &&
+                (pass || !_identity_map || !_identity_map->reserved(a))) {
+                addr = a;
+                break;
+            }
+        }
+    }
+    if (addr < 0) {
+        return -1;
+    }
+    send_command_special(PROGRAM_SHORT_ADDR, (addr << 1) + 1);
+    dali_identity id;
+    if (_identity_map && read_identity(addr, id)) {
+        int known = _identity_map->find(id);
+        // Only when free, a light holding it that does not answer may only
+        // be switched off, handle_replacements decides about those
+        if (known >= 0 && known != addr && known < 63 &&
+            !(used & ((uint64_t)1 << known))) {
+            // Still selected by the search address
+            send_command_special(PROGRAM_SHORT_ADDR, (known << 1) + 1);
+            addr = known;
+        }
+        _identity_map->set(id, addr);
+    }
+    // Tell unit to withdraw (no longer respond to search queries)
+    send_command_special(WITHDRAW, 0x00);
+    forget_address(addr);
+    return addr;
+}
+
+bool DALIDriver::read_identity(uint8_t addr, dali_identity &id)
+{
+    ApiScope scope(this, API_READ_IDENTITY);
+    // Memory bank 0, READ MEMORY LOCATION moves DTR0 on by one
+    send_command_special(DTR1, 0x00);
+    send_command_special(DTR0, 0x03);
+    for (int i = 0; i < 6; i++) {
+        send_command_standard(addr, READ_MEM_LOC);
+        int resp = encoder.recv();
+        if (resp < 0) {
+            return false;
+        }
+        id.gtin[i] = resp;
+    }
+    send_command_special(DTR0, 0x0B);
+    for (int i = 0; i < 8; i++) {
+        send_command_standard(addr, READ_MEM_LOC);
+        int resp = encoder.recv();
+        if (resp < 0) {
+            return false;
+        }
+        id.serial[i] = resp;
+    }
+    return true;
+}
+
+void DALIDriver::set_identity_map(DALIIdentityMap *map)
+{
+    _identity_map = map;
+}
+
+int DALIDriver::handle_replacements()
+{
+    ApiScope scope(this, API_HANDLE_REPLACEMENTS);
+    // Nothing to do unless gear without short address is on the bus
+    send_command_special(INITIALISE, 0xFF);
+    send_command_special(INITIALISE, 0xFF);
+    send_command_special(RANDOMISE, 0x00);
+    send_command_special(RANDOMISE, 0x00);
+    encoder.idle(100000);
+    uint32_t random_addr;
+    bool found = search_lowest(false, random_addr);
+    if (!found) {
+        send_command_special(TERMINATE, 0x00);
+        return 0;
+    }
+
+    uint64_t missing = 0;
+    for (int addr = 0; addr < 64; addr++) {
+        if (!(_light_addrs & ((uint64_t)1 << addr))) {
+            continue;
+        }
+        send_command_standard(addr, QUERY_CONTROL_GEAR_PRESENT);
+        if (encoder.recv() < 0) {
+            missing |= (uint64_t)1 << addr;
+        }
+    }
+    uint64_t replaced = 0;
+    while (missing && found) {
+        set_search_address(random_addr);
+        int addr = match_replacement(missing, _light_addrs | _input_addrs);
+        // Withdrawn either way, unmatched gear is left for add_new_devices
+        send_command_special(WITHDRAW, 0x00);
+        if (addr >= 0) {
+            missing &= ~((uint64_t)1 << addr);
+            replaced |= (uint64_t)1 << addr;
+        }
+        found = search_lowest(false, random_addr);
+    }
+    send_command_special(TERMINATE, 0x00);
+
+    int count = 0;
+    for (int addr = 0; addr < 64; addr++) {
+        if (replaced & ((uint64_t)1 << addr)) {
+            restore_address(addr);
+            count++;
+        }
+    }
+    return count;
+}
+
+int DALIDriver::compact_addresses(uint8_t *mapping, bool drop_missing)
+{
+    ApiScope scope(this, API_COMPACT_ADDRESSES);
+    // A device that does not answer may only be switched off and still
+    // holds its address, it stays there unless the caller removed it
+    uint64_t missing = 0;
+    for (int addr = 0; addr < 64; addr++) {
+        uint64_t bit = (uint64_t)1 << addr;
+        if (_light_addrs & bit) {
+            send_command_standard(addr, QUERY_CONTROL_GEAR_PRESENT);
+            if (encoder.recv() < 0) {
+                missing |= bit;
+            }
+        } else if ((_input_addrs & bit) &&
+                   query_instances(addr) == (uint32_t)-1) {
+            missing |= bit;
+        }
+        if (!(missing & bit) || !drop_missing) {
+            continue;
+        }
+        if (_light_addrs & bit) {
+            num_lights--;
+        } else {
+            num_inputs--;
+        }
+        _light_addrs &= ~bit;
+        _input_addrs &= ~bit;
+        forget_address(addr);
+        if (_identity_map) {
+            _identity_map->forget_address(addr);
+        }
+        missing &= ~bit;
+    }
+    // Wanted address of the device now at each address and the address it
+    // started from, the addresses of missing devices are skipped
+    uint8_t target[64];
+    uint8_t origin[64];
+    memset(target, 0xFF, sizeof(target));
+    int next = 0;
+    int start = -1;
+    for (int input = 0; input < 2; input++) {
+        uint64_t devices = (input ? _input_addrs : _light_addrs) & ~missing;
+        for (int addr = 0; addr < 64; addr++) {
+            if (!(devices & ((uint64_t)1 << addr))) {
+                continue;
+            }
+            while (missing & ((uint64_t)1 << next)) {
+                next++;
+            }
+            if (input && start < 0) {
+                start = next;
+            }
+            target[addr] = next++;
+        }
+    }
+    if (start < 0) {
+        start = next;
+    }
+    for (int addr = 0; addr < 64; addr++) {
+        origin[addr] = addr;
+    }
+
+    int moved = 0;
+    while (true) {
+        uint64_t used = _light_addrs | _input_addrs;
+        int from = -1;
+        int to = -1;
+        int blocked = -1;
+        for (int addr = 0; addr < 64 && from < 0; addr++) {
+            if (target[addr] == 0xFF || target[addr] == addr) {
+                continue;
+            }
+            if (!(used & ((uint64_t)1 << target[addr]))) {
+                from = addr;
+                to = target[addr];
+            } else if (blocked < 0) {
+                blocked = addr;
+            }
+        }
+        if (from < 0 && blocked >= 0) {
+            // Only cycles left, park one device above the compact range
+            for (int addr = next; addr < 64 && to < 0; addr++) {
+                if (!(used & ((uint64_t)1 << addr))) {
+                    from = blocked;
+                    to = addr;
+                }
+            }
+            if (from < 0) {
+                // Nowhere to park, devices are not at their targets
+                moved = -1;
+                break;
+            }
+        }
+        if (from < 0) {
+            break;
+        }
+        if (!move_device(from, to)) {
+            moved = -1;
+            break;
+        }
+        target[to] = target[from];
+        target[from] = 0xFF;
+        origin[to] = origin[from];
+        if (target[to] == to) {
+            moved++;
+        }
+    }
+    if (mapping) {
+        uint64_t used = _light_addrs | _input_addrs;
+        memset(mapping, 0xFF, 64);
+        for (int addr = 0; addr < 64; addr++) {
+            if (used & ((uint64_t)1 << addr)) {
+                mapping[origin[addr]] = addr;
+            }
+        }
+    }
+    if (moved >= 0) {
+        inputs_start = start;
+    }
+    return moved;
+}
+
+bool DALIDriver::move_device(uint8_t from, uint8_t to)
+{
+    if (_input_addrs & ((uint64_t)1 << from)) {
+        // Put the new address in DTR0, then set short address to DTR0
+        send_command_special_input(0x30, to);
+        send_command_standard_input(from, 0xFE, 0x14);
+        send_command_standard_input(from, 0xFE, 0x14);
+        if (query_instances(to) == (uint32_t)-1) {
+            return false;
+        }
+    } else {
+        send_with_dtr0(from, SET_SHORT_ADDR, (to << 1) + 1);
+        send_command_standard(to, QUERY_CONTROL_GEAR_PRESENT);
+        if (encoder.recv() < 0) {
+            return false;
+        }
+    }
+    move_address(from, to);
+    return true;
+}
+
+void DALIDriver::move_address(uint8_t from, uint8_t to)
+{
+    uint64_t from_bit = (uint64_t)1 << from;
+    uint64_t to_bit = (uint64_t)1 << to;
+    forget_address(to);
+    _light_addrs &= ~to_bit;
+    _input_addrs &= ~to_bit;
+    if (_light_addrs & from_bit) {
+        _light_addrs = (_light_addrs & ~from_bit) | to_bit;
+    }
+    if (_input_addrs & from_bit) {
+        _input_addrs = (_input_addrs & ~from_bit) | to_bit;
+    }
+    if (_groups_seen & from_bit) {
+        _groups[to] = _groups[from];
+        _groups_known |= _groups_known & from_bit ? to_bit : 0;
+        _groups_seen |= to_bit;
+    }
+    if (_config_known & from_bit) {
+        _config[to] = _config[from];
+        _config_known |= to_bit;
+    }
+    _phm[to] = _phm[from];
+    _tc_coolest[to] = _tc_coolest[from];
+    _tc_warmest[to] = _tc_warmest[from];
+    memcpy(_rgbwaf[to], _rgbwaf[from], sizeof(_rgbwaf[to]));
+    _level_sent[to] = _level_sent[from];
+    if (_level_pending[from] >= 0) {
+        _level_pending[to] = _level_pending[from];
+        _level_pending_us[to] = _level_pending_us[from];
+        _levels_held++;
+    }
+    if (_scene_cache) {
+        _scene_cache->move_address(from, to);
+    }
+    forget_address(from);
+    dali_identity id;
+    if (_identity_map && _identity_map->get(from, id)) {
+        _identity_map->set(id, to);
+    }
+}
+
+int DALIDriver::match_replacement(uint64_t missing, uint64_t used)
+{
+    int only = -1;
+    int num_missing = 0;
+    for (int addr = 0; addr < 64; addr++) {
+        if (missing & ((uint64_t)1 << addr)) {
+            only = addr;
+            num_missing++;
+        }
+    }
+    if (num_missing == 1) {
+        send_command_special(PROGRAM_SHORT_ADDR, (only << 1) + 1);
+        dali_identity id;
+        if (_identity_map && read_identity(only, id)) {
+            _identity_map->set(id, only);
+        }
+        return only;
+    }
+    if (!_identity_map) {
+        return -1;
+    }
+    // Temporary address to read the identity from
+    int temp = -1;
+    for (int addr = 0; addr < 63 && temp < 0; addr++) {
+        if (!(used & ((uint64_t)1 << addr))) {
+            temp = addr;
+        }
+    }
+    dali_identity id;
+    if (temp < 0) {
+        return -1;
+    }
+    send_command_special(PROGRAM_SHORT_ADDR, (temp << 1) + 1);
+    int match = -1;
+    if (read_identity(temp, id)) {
+        for (int addr = 0; addr < 64; addr++) {
+            dali_identity old_id;
+            if ((missing & ((uint64_t)1 << addr)) &&
+                _identity_map->get(addr, old_id) &&
+                !memcmp(old_id.gtin, id.gtin, sizeof(id.gtin))) {
+                // Two missing lights of the same product cannot be told
+                match = match < 0 ? addr : -2;
+            }
+        }
+    }
+    if (match < 0) {
+        send_command_special(PROGRAM_SHORT_ADDR, DALI_MASK);
+        return -1;
+    }
+    send_command_special(PROGRAM_SHORT_ADDR, (match << 1) + 1);
+    _identity_map->set(id, match);
+    return match;
+}
+
+void DALIDriver::restore_address(uint8_t addr)
+{
+    // What the address should have, before the caches forget it
+    uint64_t bit = (uint64_t)1 << addr;
+    // The missing light no longer answered group queries, its last known
+    // groups are still right
+    bool groups_known = (_groups_known | _groups_seen) & bit;
+    uint16_t groups = _groups[addr];
+    bool config_known = _config_known & bit;
+    gear_config config = _config[addr];
+    uint8_t rgbwaf[6];
+    memcpy(rgbwaf, _rgbwaf[addr], sizeof(rgbwaf));
+    scene_entry scenes[SCENE_COUNT];
+    uint16_t scenes_known = 0;
+    for (int scene = 0; scene < SCENE_COUNT && _scene_cache; scene++) {
+        if (_scene_cache->known(addr, scene)) {
+            scenes[scene] = _scene_cache->get(addr, scene);
+            scenes_known |= 1 << scene;
+        }
+    }
+    forget_address(addr);
+
+    // Each step reads the new gear first and only writes the differences
+    if (groups_known) {
+        restore_groups(addr, groups);
+    }
+    if (config_known) {
+        apply_config(&addr, &config, 1);
+    }
+    // Scene levels share DTR0 loads, colour scenes need their colour
+    // staged first
+    begin_batch();
+    for (int scene = 0; scene < SCENE_COUNT; scene++) {
+        const scene_entry &entry = scenes[scene];
+        if (!(scenes_known & (1 << scene)) || entry.level == DALI_MASK ||
+            (entry.color_type != SCENE_COLOR_NONE &&
+             entry.color_type != SCENE_COLOR_UNKNOWN)) {
+            continue;
+        }
+        set_scene(addr, scene, entry.level);
+    }
+    end_batch();
+    for (int scene = 0; scene < SCENE_COUNT; scene++) {
+        const scene_entry &entry = scenes[scene];
+        if (!(scenes_known & (1 << scene)) || entry.level == DALI_MASK) {
+            continue;
+        }
+        if (entry.color_type == SCENE_COLOR_TEMPERATURE) {
+            uint16_t mirek = entry.color[0] | (entry.color[1] << 8);
+            stage_color(addr, color_mirek_to_kelvin(mirek));
+        } else if (entry.color_type == SCENE_COLOR_RGB) {
+            stage_color(addr, entry.color[0], entry.color[1], entry.color[2],
+                        entry.color[3]);
+        } else {
+            continue;
+        }
+        send_with_dtr0(addr, SET_SCENE + scene, entry.level);
+        if (_scene_cache) {
+            _scene_cache->set(addr, scene, entry);
+        }
+    }
+    // Last colour shown, only the channels that are known
+    uint8_t mask = 0;
+    for (int channel = 0; channel < 6; channel++) {
+        if (rgbwaf[channel] != DALI_MASK) {
+            mask |= 1 << channel;
+        }
+    }
+    if (mask) {
+        set_rgbwaf(addr, rgbwaf, mask);
+    }
+}
+
+bool DALIDriver::restore_groups(uint8_t addr, uint16_t groups)
+{
+    // New gear is usually in no group, so mostly adds are sent
+    uint16_t current = 0;
+    get_groups(addr, current);
+    uint16_t diff = current ^ groups;
+    for (int g = 0; g < 16; g++) {
+        if (diff & (1 << g)) {
+            bool add = groups & (1 << g);
+            send_twice(addr, (add ? ADD_TO_GROUP : REMOVE_FROM_GROUP) + g);
+        }
+    }
+    return read_group_membership(addr) && _groups[addr] == groups;
+}
+
 // Return number of logical units on the bus
 int DALIDriver::assign_addresses_input(bool reset, int num_found)
 {
+    ApiScope scope(this, API_ASSIGN_ADDRESSES_INPUT);
     send_command_special(TERMINATE, 0x00);
     uint8_t numAssignedShortAddresses = num_found;
     int assignedAddresses[63] = {false};
     int highestAssigned = -1;
+    // Lights restored from the identity map may leave holes, number the
+    // inputs from above the highest light and skip any light address
+    int next_addr = 64 - (_light_addrs ? __builtin_clzll(_light_addrs) : 64);
 
     // Put 0x00 in DTR0
     send_command_special_input(0x30, 0x00);
@@ -657,7 +2489,7 @@ int DALIDriver::assign_addresses_input(bool reset, int num_found)
     // Assign all units a random address
     send_command_special_input(0x02, 0x00);
     send_command_special_input(0x02, 0x00);
-    wait_ms(100);
+    encoder.idle(100000);
 
     while (true) {
         // Set the search address to the highest range
@@ -692,8 +2524,15 @@ int DALIDriver::assign_addresses_input(bool reset, int num_found)
             if (yes) {
                 // We found a unit, let's program the short address with a new
                 // address Give it a temporary short address
-                uint8_t new_addr = numAssignedShortAddresses;
-                if (new_addr < 63) {
+                int new_addr = -1;
+                for (int i = 0; i < 63 && new_addr < 0; i++) {
+                    int addr = (next_addr + i) % 63;
+                    if (!(_light_addrs & ((uint64_t)1 << addr)) &&
+                        !assignedAddresses[addr]) {
+                        new_addr = addr;
+                    }
+                }
+                if (new_addr >= 0) {
                     if (assignedAddresses[new_addr] == true) {
                         // Duplicate addr?
                     } else {
@@ -704,6 +2543,8 @@ int DALIDriver::assign_addresses_input(bool reset, int num_found)
                         send_command_special_input(0x04, 0x00);
                         numAssignedShortAddresses++;
                         assignedAddresses[new_addr] = true;
+                        _input_addrs |= (uint64_t)1 << new_addr;
+                        next_addr = new_addr + 1;
                         if (new_addr > highestAssigned)
                             highestAssigned = new_addr;
                     }
@@ -713,6 +2554,9 @@ int DALIDriver::assign_addresses_input(bool reset, int num_found)
             } else {
                 // No device found
             }
+        } else {
+            // No short address left for the devices still searching
+            break;
         }
         // Refresh initialization state
         send_command_special_input(0x01, 0x7F);
@@ -17,65 +17,163 @@
 #ifndef DALI_DRIVER_H
 #define DALI_DRIVER_H
 
+#include "DALIColor.h"
+#include "DALICommands.h"
+#include "DALICurve.h"
+#include "DALIIdentityMap.h"
+#include "DALISceneCache.h"
 #include "manchester/encoder.h"
 #include "mbed.h"
 
-// Special commands that do not address a specific device
-// These values will be used as address byte in DALI command
-enum SpecialCommandOpAddr {
-    SEARCHADDRH = 0xB1,
-    SEARCHADDRM = 0xB3,
-    SEARCHADDRL = 0xB5,
-    DTR0 = 0xA3,
-    DTR1 = 0xC3,
-    DTR2 = 0xC5,
-    INITIALISE = 0xA5,
-    RANDOMISE = 0xA7,
-    PROGRAM_SHORT_ADDR = 0xB7,
-    QUERY_SHORT_ADDR = 0xBB,
-    COMPARE = 0xA9,
-    TERMINATE = 0xA1,
-    ENABLE_DEVICE_TYPE = 0xC1,
-    WITHDRAW = 0xAB
+enum InstanceType { GENERIC = 0, OCCUPANCY = 3, LIGHT = 4, BUTTON = 1 };
+enum ColorType { RGB, TEMPERATURE, UNSUPPORTED };
+
+// Configuration parameters of a control gear, bits of the fields argument of
+// apply_config
+enum ConfigField {
+    CONFIG_FADE_TIME = 0x01,
+    CONFIG_FADE_RATE = 0x02,
+    CONFIG_MIN_LEVEL = 0x04,
+    CONFIG_MAX_LEVEL = 0x08,
+    CONFIG_POWER_ON_LEVEL = 0x10,
+    CONFIG_FAILURE_LEVEL = 0x20,
+    CONFIG_ALL = 0x3F
 };
 
-// Command op codes
-enum CommandOpCodes {
-    GO_TO_SCENE = 0x10,
-    OFF = 0x00,
-    ON_AND_STEP_UP = 0x08,
-    QUERY_GEAR_GROUPS_L = 0xC0, // get lower byte of gear groups status
-    QUERY_GEAR_GROUPS_H = 0xC1, // get upper byte of gear groups status
-    QUERY_ACTUAL_LEVEL = 0xA0,
-    QUERY_ERROR = 0x90,
-    QUERY_PHM = 0x9A,
-    QUERY_FADE = 0xA5,
-    QUERY_COLOR_TYPE_FEATURES = 0xF9,
-    QUERY_SCENE_LEVEL = 0xB0,
-    READ_MEM_LOC = 0xC5,
-    SET_TEMP_RGB_DIM = 0xEB,
-    SET_TEMP_TEMPC = 0xE7,
-    SET_TEMP_WAF_DIM = 0xEC,
-    COLOR_ACTIVATE = 0xE2,
-
-    // Commands below are "send twice"
-    SET_SCENE = 0x40,
-    SET_FADE_TIME = 0x2E,
-    SET_FADE_RATE = 0x2F,
-    SET_MIN_LEVEL = 0x2B,
-    REMOVE_FROM_SCENE = 0x50,
-    REMOVE_FROM_GROUP = 0x70,
-    STORE_DTR_AS_SCENE =0x40,
-    ADD_TO_GROUP = 0x60,
-    SET_SHORT_ADDR = 0x80,
-    SET_MAX_LEVEL = 0x2A
+// Configuration of a control gear, see iec62386-102 section 9
+struct gear_config {
+    // Fade time [0, 15] and fade rate [1, 15]
+    uint8_t fade_time;
+    uint8_t fade_rate;
+    uint8_t min_level;
+    uint8_t max_level;
+    // Levels after power on and after a bus failure, DALI_MASK keeps the
+    // last level
+    uint8_t power_on_level;
+    uint8_t failure_level;
 };
 
-enum InstanceType { GENERIC = 0, OCCUPANCY = 3, LIGHT = 4, BUTTON = 1 };
-enum ColorType { RGB, TEMPERATURE, UNSUPPORTED };
+// Public calls timed by the driver statistics
+enum DALIApi {
+    API_INIT,
+    API_INIT_LIGHTS,
+    API_INIT_INPUTS,
+    API_ASSIGN_ADDRESSES,
+    API_ASSIGN_ADDRESSES_INPUT,
+    API_ADD_NEW_DEVICES,
+    API_READ_IDENTITY,
+    API_HANDLE_REPLACEMENTS,
+    API_COMPACT_ADDRESSES,
+    API_ADD_TO_GROUP,
+    API_REMOVE_FROM_GROUP,
+    API_READ_GROUP_MEMBERSHIP,
+    API_APPLY_GROUP_MEMBERSHIP,
+    API_SET_LEVEL,
+    API_TURN_OFF,
+    API_TURN_ON,
+    API_GET_LEVEL,
+    API_GET_ERROR,
+    API_GET_FADE,
+    API_GET_PHM,
+    API_QUERY_ANY,
+    API_FIND_ANSWERING,
+    API_QUERY_COLOR_TYPE_FEATURES,
+    API_SET_COLOR,
+    API_SET_COLOR_SCENE,
+    API_SET_COLOR_XY,
+    API_SET_RGBWAF,
+    API_STAGE_COLOR,
+    API_ACTIVATE_COLOR,
+    API_QUERY_TC_LIMITS,
+    API_SET_FADE_TIME,
+    API_SET_FADE_RATE,
+    API_SET_MIN_LEVEL,
+    API_SET_MAX_LEVEL,
+    API_SET_POWER_ON_LEVEL,
+    API_SET_SYSTEM_FAILURE_LEVEL,
+    API_READ_CONFIG,
+    API_APPLY_CONFIG,
+    API_END_BATCH,
+    API_SET_SCENE,
+    API_REMOVE_FROM_SCENE,
+    API_GO_TO_SCENE,
+    API_CAPTURE_SCENE,
+    API_READ_SCENES,
+    API_GET_SCENE_LEVEL,
+    API_QUERY_INSTANCES,
+    API_GET_INSTANCE_TYPE,
+    API_GET_INSTANCE_STATUS,
+    API_GET_TEMPERATURE,
+    API_GET_HUMIDITY,
+    API_COUNT
+};
+
+// Configuration commands held back by begin_batch before they are sent
+#define BATCH_MAX_COMMANDS 128
+
+// Bucket 0 of the latency histogram counts calls shorter than 32.768 ms,
+// bucket i calls shorter than 32.768 ms << i, the last bucket the rest
+#define DALI_LATENCY_BUCKETS 10
+
+// frames, answers and the times include the public calls made from inside a
+// call (init counts the frames of assign_addresses), the own_ fields leave
+// them out so they add up to the bus traffic over all calls
+struct dali_api_stats {
+    uint32_t calls;
+    // Forward frames sent during the calls
+    uint32_t frames;
+    // Backward frames received during the calls
+    uint32_t answers;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t latency[DALI_LATENCY_BUCKETS];
+    // Frames, answers and time outside of nested calls
+    uint32_t own_frames;
+    uint32_t own_answers;
+    uint64_t own_us;
+};
+
+// Snapshot of the driver statistics, see DALIDriver::get_stats
+struct dali_stats {
+    // Counters kept by the encoder
+    encoder_stats bus;
+    // Forward frames sent, by command type
+    uint32_t standard_frames;
+    uint32_t special_frames;
+    uint32_t direct_frames;
+    uint32_t input_standard_frames;
+    uint32_t input_special_frames;
+    // Commands sent again after a failed verification
+    uint32_t retries;
+    // set_level calls held back by the level filter
+    uint32_t suppressed_levels;
+    dali_api_stats api[API_COUNT];
+};
 
 #define YES 0xFF
 
+// RGBWAF colour channels, bits of the set_rgbwaf channel mask
+enum RGBWAFChannel {
+    CHANNEL_RED = 0x01,
+    CHANNEL_GREEN = 0x02,
+    CHANNEL_BLUE = 0x04,
+    CHANNEL_WHITE = 0x08,
+    CHANNEL_AMBER = 0x10,
+    CHANNEL_FREECOLOUR = 0x20,
+    CHANNEL_ALL = 0x3F
+};
+
+// Units of the set_level filter threshold
+enum LevelFilterUnit {
+    // Arc power levels
+    FILTER_STEPS,
+    // Relative change of the light output on the logarithmic curve
+    FILTER_PERCENT
+};
+
+// Addresses tracked by the level filter: 64 short, 16 group and broadcast
+#define LEVEL_FILTER_ADDRS 81
+
 class DALIDriver {
 public:
     /** Constructor DALIDriver
@@ -111,6 +209,77 @@ public:
      */
     int init_inputs();
 
+    /** Give short addresses to devices connected since init
+     *
+     *   Only control gear and input devices without a short address take
+     *   part in the search, each gets the lowest address not used by any
+     *   light or input device. Devices that already have an address are not
+     *   touched.
+     *
+     *   @returns    the number of devices added
+     */
+    int add_new_devices();
+
+    /** Keep short addresses of control gear across commissioning
+     *
+     *   With a map attached, commissioning reads the identity of every gear
+     *   found and gives it the address the map holds for it when free, then
+     *   records the address given in the map.
+     *
+     *   @param map      Identity map to use and update, NULL to stop
+     */
+    void set_identity_map(DALIIdentityMap *map);
+
+    /** Give replaced lights their old address and configuration
+     *
+     *   Looks for new gear without a short address, and only when there is
+     *   some for lights that stopped answering. A new light takes the
+     *   address of the missing one when only one is missing, or, with an
+     *   identity map attached, when only one missing light has the same
+     *   GTIN. The cached groups, configuration, scenes and colour of the
+     *   address are then written to it, skipping what the new light already
+     *   has. New lights that cannot be matched are left without address for
+     *   add_new_devices.
+     *
+     *   @returns    the number of lights replaced
+     */
+    int handle_replacements();
+
+    /** Renumber the devices to consecutive short addresses
+     *
+     *   Lights are moved to the lowest addresses and input devices follow
+     *   from get_input_addr_start(), both keeping their order. Each move
+     *   sets the new address through DTR0, checks the device answers there
+     *   and then moves everything cached about it, including the identity
+     *   map entry. Devices swapping addresses pass through a free address.
+     *
+     *   A device that does not answer may only be switched off and would
+     *   come back with its old address, so by default it keeps that
+     *   address and its cached state, and the others are packed around it.
+     *   handle_replacements can still give it to a replacement.
+     *
+     *   @param mapping      Optional, 64 entries filled with the new address
+     *   of the device at each old address, 0xFF where there is none
+     *   @param drop_missing Forget devices that do not answer, with their
+     *   cached state and identity, and reuse their addresses. Only when they
+     *   were removed from the bus for good
+     *   @returns            the number of devices moved, -1 when the
+     *   renumbering stopped early: a device did not answer at its new
+     *   address, or devices swapping addresses found no free address
+     *   NOTE: a health monitor must be told with remap for each move
+     */
+    int compact_addresses(uint8_t *mapping = NULL, bool drop_missing = false);
+
+    /** Read the GTIN and serial number of a control gear from memory bank 0
+     *
+     *   @param addr     short address of the gear
+     *   @param id       filled with the identity
+     *   @returns
+     *       false if the gear did not answer every location
+     *
+     */
+    bool read_identity(uint8_t addr, dali_identity &id);
+
     /** Attach a callback when input event is generated
      *
      *   @param status_cb callback to take in the 32 bit event message
@@ -168,6 +337,22 @@ public:
      */
     void send_command_direct(uint8_t address, uint8_t opcode);
 
+    /** Queue configuration commands instead of sending them
+     *
+     *   Commands that load DTR0 and are sent twice (set_scene, set_fade_time,
+     *   set_fade_rate, set_min_level, set_max_level, set_power_on_level,
+     *   set_system_failure_level) are queued until end_batch, and sent as one
+     *   DTR0 load followed by every command taking that value. Repeating a
+     *   command for the same address only keeps the last value. Any other
+     *   frame sends the queue first, so DTR contents stay correct.
+     *   NOTE: calls nest, only the outermost end_batch sends the queue
+     */
+    void begin_batch();
+
+    /** Send the commands queued since begin_batch
+     */
+    void end_batch();
+
     /** Get the address of a group
      *
      *   @param group_number    The group number [0-15]
@@ -197,15 +382,83 @@ public:
      */
     bool remove_from_group(uint8_t addr, uint8_t group);
 
+    /** Read the groups of a device into the group cache
+     *
+     *   @param addr    short address of the device
+     *   @returns
+     *       false if the device did not answer
+     *
+     */
+    bool read_group_membership(uint8_t addr);
+
+    /** Get the groups of a device, read from the bus when not cached
+     *
+     *   @param addr    short address of the device
+     *   @param groups  filled with bit n set for group n
+     *   @returns
+     *       false if the device did not answer
+     *
+     */
+    bool get_groups(uint8_t addr, uint16_t &groups);
+
+    /** Set the groups of several devices
+     *
+     *   Only the group commands that change something are sent, through a
+     *   group or broadcast address when all its members take the same
+     *   change. The groups are checked with one readback per device at the
+     *   end, and commands that did not take effect are sent once more.
+     *
+     *   @param addrs   short addresses of the devices
+     *   @param masks   groups for each device, bit n set for group n
+     *   @param n       number of devices
+     *   @returns
+     *       number of devices that ended up in the requested groups
+     *
+     */
+    int apply_group_membership(const uint8_t *addrs, const uint16_t *masks,
+                               uint8_t n);
+
     /** Set the light output for a device/group
      *
      *   @param addr    8 bit address (device or group)
      *   @param level   Light output level [0,254]
-     *   NOTE: Refer to section 9.3 of iec62386-102 for dimming curve
+     *   NOTE: Refer to section 9.3 of iec62386-102 for dimming curve,
+     *   DALICurve.h converts percent and light output fractions to levels
      *
      */
     void set_level(uint8_t addr, uint8_t level);
 
+    /** Hold back set_level calls that change the level too little to see
+     *
+     *   @param threshold    Smallest change sent at once, 0 disables the
+     * filter
+     *   @param unit         Unit of threshold
+     *   @param max_hold_ms  A held back level is sent by the first tick,
+     * set_level or flush_levels call after this time
+     *   NOTE: Turning off and on, and MASK (0xFF), are always sent. Call tick
+     * periodically, or
+     * flush_levels when a stream of levels ends, so the last level reaches
+     * the bus
+     */
+    void set_level_filter(uint8_t threshold,
+                          LevelFilterUnit unit = FILTER_STEPS,
+                          uint32_t max_hold_ms = 1000);
+
+    /** Send the levels held back by the level filter
+     *
+     *   @param max_age_ms   Only send levels held back at least this long
+     *   @returns            Number of levels sent
+     */
+    int flush_levels(uint32_t max_age_ms = 0);
+
+    /** Send the levels held back by the level filter for max_hold_ms
+     *
+     *   Cheap when nothing is due, meant to be called from the main loop.
+     *
+     *   @returns            Number of levels sent
+     */
+    int tick();
+
     /** Turn a device/group off
      *
      *   @param addr    8 bit address (device or group)
@@ -283,6 +536,38 @@ public:
     */ 
     bool query_temperature_capable(uint8_t addr);
 
+    /** Query if the light is capable of xy-coordinates
+    *
+    * @param addr 8 bit address of the light
+    *
+    * @returns boolean representing support
+    *
+    */
+    bool query_xy_capable(uint8_t addr);
+
+    /** Query the physical colour temperature limits of a light
+    *
+    *   The limits are cached, later set_color calls to the address are
+    *   clamped to them
+    *
+    *   @param addr     short address of the light
+    *   @param coolest  filled with the coolest colour temperature in mirek
+    *   @param warmest  filled with the warmest colour temperature in mirek
+    *   @returns        false if the light did not answer
+    *
+    */
+    bool query_tc_limits(uint8_t addr, uint16_t &coolest, uint16_t &warmest);
+
+    /** Get the colour temperature in mirek sent to a light
+    *
+    *   @param addr     short address of the light
+    *   @param temp     colour temperature in Kelvin
+    *   @returns        the mirek value, clamped to the limits cached by
+    *   query_tc_limits
+    *
+    */
+    uint16_t temp_to_mirek(uint8_t addr, uint16_t temp);
+
     /** Query number of rgbwaf channels 
     *
     * @param addr 8 bit address of the light
@@ -303,6 +588,80 @@ public:
     */ 
     void set_color(uint8_t addr, uint8_t r, uint8_t g, uint8_t b, uint8_t dim = 0);
 
+    /** Load a colour temperature into a light without showing it
+    *
+    *   The light keeps its colour until activate_color, so lights staged
+    *   one by one can change together with a single group or broadcast
+    *   activation
+    *
+    *   @param addr     short address of the light
+    *   @param temp     light temperature in kelvin
+    *
+    */
+    void stage_color(uint8_t addr, uint16_t temp);
+
+    /** Load RGB and white levels into a light without showing them
+    *
+    *   @param addr 8 bit address of the light
+    *   @param r    level of red [0,254]
+    *   @param g    level of green [0,254]
+    *   @param b    level of blue [0,254]
+    *   @param dim  level of dim [0,254]
+    *
+    */
+    void stage_color(uint8_t addr, uint8_t r, uint8_t g, uint8_t b,
+                     uint8_t dim = 0);
+
+    /** Load an xy chromaticity into a light without showing it
+    *
+    *   @param addr     8 bit address of the light
+    *   @param x        x-coordinate in 1/65536
+    *   @param y        y-coordinate in 1/65536
+    *
+    */
+    void stage_color_xy(uint8_t addr, uint16_t x, uint16_t y);
+
+    /** Show the staged colours
+    *
+    *   @param addr     8 bit address, a group or broadcast_addr switches
+    * all staged lights in the same frame
+    *
+    */
+    void activate_color(uint8_t addr);
+
+    /** Set any of the six RGBWAF channels of several lights
+    *
+    *   Channels outside the mask keep their level. Channels the driver
+    *   already set to the same level are not sent again; scene recalls and
+    *   activations make it forget the levels of the lights they reach, but
+    *   changes by other masters are not seen, use force then. Every address
+    *   is staged and activated as given, short addresses are never replaced
+    *   by a group; to switch many lights in one frame stage them and call
+    *   activate_color with a group address.
+    *
+    *   @param addrs    8 bit addresses of the lights
+    *   @param n        number of addresses
+    *   @param levels   red, green, blue, white, amber and freecolour levels
+    * [0,254]
+    *   @param mask     RGBWAFChannel bits of the channels to set
+    *   @param force    send every channel in mask even if already set
+    *
+    */
+    void set_rgbwaf(const uint8_t *addrs, uint8_t n, const uint8_t *levels,
+                    uint8_t mask = CHANNEL_ALL, bool force = false);
+
+    /** Set any of the six RGBWAF channels of a light
+    *
+    *   @param addr     8 bit address of the light
+    *   @param levels   red, green, blue, white, amber and freecolour levels
+    * [0,254]
+    *   @param mask     RGBWAFChannel bits of the channels to set
+    *   @param force    send every channel in mask even if already set
+    *
+    */
+    void set_rgbwaf(uint8_t addr, const uint8_t *levels,
+                    uint8_t mask = CHANNEL_ALL, bool force = false);
+
     /** Set the color scene
     *
     *   @param addr 8 bit address of the light
@@ -332,6 +691,16 @@ public:
     */
     void set_color_scene(uint8_t addr, uint8_t scene, uint16_t temp);
 
+    /** Set the color as CIE 1931 xy chromaticity
+    *
+    *   @param addr     8 bit address of the light
+    *   @param x        x-coordinate in 1/65536
+    *   @param y        y-coordinate in 1/65536
+    *
+    *   NOTE: DALIColor.h converts RGB and colour temperature to xy
+    */
+    void set_color_xy(uint8_t addr, uint16_t x, uint16_t y);
+
 
     /** Set the event scheme -- section 9.6.3 of iec62386-103
      * 0 (default) -Instance addressing, using instance type and number.
@@ -429,6 +798,42 @@ public:
      */
     uint8_t get_phm(uint8_t addr);
 
+    /** Ask a yes/no question to a device, group or the whole bus
+     *
+     *   @param addr    8 bit address (device or group)
+     *   @param opcode  query only answered by gear for which it is true, e.g.
+     * QUERY_LAMP_FAILURE
+     *   @returns
+     *       true if anything answered, overlapping answers of several gear
+     * count as yes
+     *
+     */
+    bool query_any(uint8_t addr, uint8_t opcode);
+
+    /** Find the lights answering yes to a yes/no query
+     *
+     *   Asks the whole bus first, and only when something answers bisects
+     *   the lights through the groups in the group cache, asking single
+     *   lights only where no group splits them further. When nothing is
+     *   wrong this is one frame. Lights with unknown groups are asked one
+     *   by one, see read_group_membership.
+     *
+     *   @param opcode  query only answered by gear for which it is true
+     *   @returns
+     *       bit n set when the light at short address n answered
+     *
+     */
+    uint64_t find_answering(uint8_t opcode);
+
+    /** Find the lights with a lamp failure
+     *
+     *   @returns
+     *       bit n set when the light at short address n reports a lamp
+     * failure
+     *
+     */
+    uint64_t find_lamp_failures();
+
     /** Set the fade rate for a device/group
      *
      *   @param addr    8 bit address (device or group)
@@ -447,6 +852,77 @@ public:
      */
     void set_fade_time(uint8_t addr, uint8_t time);
 
+    /** Set the minimum light output for a device/group
+     *
+     *   @param addr    8 bit address (device or group)
+     *   @param level   Minimum level [PHM, max level], the gear clamps it
+     *
+     */
+    void set_min_level(uint8_t addr, uint8_t level);
+
+    /** Set the maximum light output for a device/group
+     *
+     *   @param addr    8 bit address (device or group)
+     *   @param level   Maximum level [min level, 254], the gear clamps it
+     *
+     */
+    void set_max_level(uint8_t addr, uint8_t level);
+
+    /** Set the light output after power on for a device/group
+     *
+     *   @param addr    8 bit address (device or group)
+     *   @param level   Level [0, 254], DALI_MASK for the last level
+     *
+     */
+    void set_power_on_level(uint8_t addr, uint8_t level);
+
+    /** Set the light output after a bus failure for a device/group
+     *
+     *   @param addr    8 bit address (device or group)
+     *   @param level   Level [0, 254], DALI_MASK for no change
+     *
+     */
+    void set_system_failure_level(uint8_t addr, uint8_t level);
+
+    /** Read the configuration of a device into the configuration cache
+     *
+     *   @param addr    short address of the device
+     *   @returns
+     *       false if the device did not answer
+     *
+     */
+    bool read_config(uint8_t addr);
+
+    /** Get the configuration of a device, read from the bus when not cached
+     *
+     *   @param addr    short address of the device
+     *   @param config  filled with the configuration
+     *   @returns
+     *       false if the device did not answer
+     *
+     */
+    bool get_config(uint8_t addr, gear_config &config);
+
+    /** Bring several devices to a configuration
+     *
+     *   The current configuration of each device is read, and only the
+     *   parameters that differ are written. Wanted values are first clamped
+     *   the way the gear stores them: fade rate to [1,15], the minimum
+     *   level to the physical minimum and the maximum, which wins when the
+     *   two cross. Writes of the same value share one DTR0 load across
+     *   devices.
+     *
+     *   @param addrs   short addresses of the devices
+     *   @param configs configuration for each device
+     *   @param n       number of devices
+     *   @param fields  ConfigField bits of the parameters to apply
+     *   @returns
+     *       number of parameters written
+     *
+     */
+    int apply_config(const uint8_t *addrs, const gear_config *configs,
+                     uint8_t n, uint8_t fields = CONFIG_ALL);
+
     /** Set the light output for a scene
      *
      *   @param addr    8 bit address (device or group)
@@ -472,6 +948,49 @@ public:
      */
     void go_to_scene(uint8_t addr, uint8_t scene);
 
+    /** Store the current level and colour of the lights as a scene
+     *
+     *   Each light stores its own actual level and colour, so a group or
+     *   broadcast captures a whole room in six frames
+     *
+     *   @param addr    8 bit address (device or group)
+     *   @param scene   scene number [0,15]
+     */
+    void capture_scene(uint8_t addr, uint8_t scene);
+
+    /** Read the scene levels of lights into the scene cache
+     *
+     *   DT8 scene colours cannot be queried, colours the driver wrote stay
+     *   cached while the level read back matches
+     *
+     *   @param addrs   short addresses of the lights
+     *   @param n       number of addresses
+     *   @returns       number of scenes read, -1 without a scene cache
+     */
+    int read_scenes(const uint8_t *addrs, uint8_t n);
+
+    /** Get the level of a scene, from the scene cache when it is known
+     *
+     *   @param addr    short address of the light
+     *   @param scene   scene number [0,15]
+     *   @returns       level, DALI_MASK when the light is not part of the
+     * scene or did not answer
+     */
+    uint8_t get_scene_level(uint8_t addr, uint8_t scene);
+
+    /** Keep a copy of the scene tables the driver writes
+     *
+     *   @param cache    Scene cache to update, NULL to stop
+     */
+    void set_scene_cache(DALISceneCache *cache);
+
+    /** Get the scene cache set with set_scene_cache, NULL without one
+     */
+    DALISceneCache *get_scene_cache()
+    {
+        return _scene_cache;
+    }
+
     /** Call recv on the bus
      *
      *   @returns    the messagein the recv buffer for the bus (encoder class)
@@ -488,11 +1007,25 @@ public:
      */
     event_msg parse_event(uint32_t msg);
 
+    /** Copy the bus and API call statistics
+     *
+     *   @param stats    Filled with the counters since the last reset
+     *   NOTE: dali_stats is large, avoid placing it on a small thread stack
+     */
+    void get_stats(dali_stats &stats);
+
+    /** Zero all bus and API call statistics
+     */
+    void reset_stats();
+
     static const uint8_t broadcast_addr = 0xFF;
 
     // The encoder for the bus signals
     ManchesterEncoder encoder;
 
+    /** Get the number of lights, gear that kept its short address from
+     * before may leave holes, see get_light_addresses
+     */
     int get_num_lights()
     {
         return num_lights;
@@ -505,13 +1038,91 @@ public:
 
     int get_input_addr_start()
     {
-        return num_lights;
+        return inputs_start;
+    }
+
+    /** Get the short addresses of the lights, bit n set for address n
+     */
+    uint64_t get_light_addresses()
+    {
+        return _light_addrs;
+    }
+
+    /** Get the short addresses of the input devices, bit n set for address n
+     */
+    uint64_t get_input_addresses()
+    {
+        return _input_addrs;
     }
 
 private:
+    // Records the latency and frame cost of a public call in its scope
+    class ApiScope {
+    public:
+        ApiScope(DALIDriver *driver, DALIApi api);
+        ~ApiScope();
+
+    private:
+        DALIDriver *_driver;
+        DALIApi _api;
+        // Enclosing scope, NULL for the outermost call
+        ApiScope *_outer;
+        uint32_t _start_us;
+        uint32_t _start_frames;
+        uint32_t _start_answers;
+        // Spent in the nested scopes
+        uint32_t _nested_us;
+        uint32_t _nested_frames;
+        uint32_t _nested_answers;
+    };
+
     void set_color_temp(uint8_t addr, uint16_t temp);
     void set_color_temp(uint8_t addr, uint8_t r, uint8_t g, uint8_t b, uint8_t dim = 0);
 
+    // Map an address to its level filter slot, -1 if it has none
+    int level_filter_index(uint8_t addr);
+
+    // Check if a level change is large enough to send, last is -1 when
+    // unknown
+    bool level_visible(int16_t last, uint8_t level);
+
+    // Send a level held back in a filter slot
+    void flush_level(int index);
+
+    // Drop the level held back in a filter slot
+    void release_level(int index);
+
+    // Forget the levels of the slots a command to addr may change, after
+    // sending the held back levels it would otherwise overtake
+    void level_override(uint8_t addr);
+
+    // Send a DAPC frame without touching the level filter
+    void send_direct(uint8_t address, uint8_t opcode);
+
+    // Load the temporary RGBWAF levels of the lights, channels outside mask
+    // are sent as DALI_MASK
+    void stage_rgbwaf(const uint8_t *addrs, uint8_t n, const uint8_t *levels,
+                      uint8_t mask);
+
+    // set_rgbwaf without the statistics scope
+    void send_rgbwaf(const uint8_t *addrs, uint8_t n, const uint8_t *levels,
+                     uint8_t mask, bool force = false);
+
+    // Forget the channel levels of the lights a command to addr reaches
+    void forget_rgbwaf(uint8_t addr);
+
+    // Load x and y into the temporary colour
+    void set_color_xy_temp(uint8_t addr, uint16_t x, uint16_t y);
+
+    // Send COLOR_ACTIVATE
+    void send_activate(uint8_t addr);
+
+    // Scene level from the cache or the bus, -1 without an answer
+    int query_scene_level(uint8_t addr, uint8_t scene);
+
+    // Read a 16 bit DT8 colour value, -1 without an answer
+    int query_color_value(uint8_t addr, uint8_t selector);
+
     // Some commands must be sent twice, utility function to do that
     void send_twice(uint8_t addr, uint8_t opcode);
 
@@ -535,14 +1146,13 @@ private:
      */
     int assign_addresses_input(bool reset = false, int num_found = 0);
 
-    /** Assign addresses to the logical units on the bus
+    /** Find the short addresses the control gear on the bus already have
      *
-     *   @returns    The number of logical units found on bus
+     *   @returns    Bitmap of the short addresses read back from the gear
      *
      *   NOTE: This process is mostly copied from page 82 of iec62386-102
-     *   The addresses will be in the range [0, number units - 1]
      */
-    int get_highest_address();
+    uint64_t get_assigned_addresses();
 
     /** Set the controller search address for luminaires
      * This address will be used in search commands to determine what
@@ -586,6 +1196,141 @@ private:
     int num_inputs;
     // Address where input devices start
     int inputs_start;
+    // Short addresses in use by lights and input devices
+    uint64_t _light_addrs;
+    uint64_t _input_addrs;
+
+    // Lowest short address below 63 used by neither lights nor inputs and
+    // not reserved in the identity map, -1 if none
+    int lowest_free_address();
+
+    // Optional identity to short address map, see set_identity_map
+    DALIIdentityMap *_identity_map;
+
+    // Give the gear selected by the search address a short address not in
+    // use, restored from the identity map when possible, and withdraw it.
+    // Returns the address, -1 when none is left
+    int program_found_gear(uint64_t used);
+
+    // Find the lowest random address among the devices still searching,
+    // false when none answers
+    bool search_lowest(bool input, uint32_t &random_addr);
+
+    // Address the gear or the input devices without a short address
+    int add_new_gear();
+    int add_new_inputs();
+
+    // Set up the event reporting and instances of an input device
+    void setup_input(uint8_t addr);
+
+    // Drop everything cached about a short address
+    void forget_address(uint8_t addr);
+
+    // Lights in set answering a yes/no query, bisecting through the groups
+    // in members. asked is true when a query reaching all of set already
+    // answered yes; untracked gear may have given that answer, so it only
+    // saves asking a group covering set again. no collects the lights known
+    // not to answer.
+    uint64_t narrow_answering(uint8_t opcode, uint64_t set, bool asked,
+                              const uint64_t *members, uint64_t &no);
+
+    // Missing light the gear selected by the search address replaces, -1
+    // if it cannot be told. Leaves the gear at its new address.
+    int match_replacement(uint64_t missing, uint64_t used);
+
+    // Write the cached configuration of an address to the gear now there
+    void restore_address(uint8_t addr);
+
+    // Set the groups of one light with short address commands only, then
+    // read them back once. Returns whether the gear has them
+    bool restore_groups(uint8_t addr, uint16_t groups);
+
+    // Give the device at from the short address to, false if it does not
+    // answer there
+    bool move_device(uint8_t from, uint8_t to);
+
+    // Move everything cached about a short address to another one
+    void move_address(uint8_t from, uint8_t to);
+
+    // Level filter settings, see set_level_filter
+    uint8_t _filter_threshold;
+    LevelFilterUnit _filter_unit;
+    uint32_t _filter_hold_us;
+    // Last level sent and the level held back per slot, -1 when unknown or
+    // nothing is held back. 0xFF is a valid level (MASK).
+    int16_t _level_sent[LEVEL_FILTER_ADDRS];
+    int16_t _level_pending[LEVEL_FILTER_ADDRS];
+    uint32_t _level_pending_us[LEVEL_FILTER_ADDRS];
+    // Number of slots holding back a level, and the earliest time one of
+    // them is due (never later than the real deadline)
+    uint8_t _levels_held;
+    uint32_t _level_due_us;
+
+    // Physical colour temperature limits in mirek per short address, 0 until
+    // queried
+    uint16_t _tc_coolest[64];
+    uint16_t _tc_warmest[64];
+
+    // RGBWAF channel levels last activated per short address, DALI_MASK when
+    // unknown
+    uint8_t _rgbwaf[64][6];
+
+    // Group membership per short address, valid when its bit in
+    // _groups_known is set
+    uint16_t _groups[64];
+    uint64_t _groups_known;
+    // Addresses whose groups were read at some point, _groups keeps the
+    // last membership known after a light stops answering
+    uint64_t _groups_seen;
+
+    // Send group changes for the devices in change, through group or
+    // broadcast addresses where possible. desired holds the wanted groups of
+    // every light in lights, returns the number of command pairs sent.
+    int send_group_changes(uint64_t lights, uint64_t change,
+                           const uint16_t *desired);
+
+    // Update the group cache after adding to or removing from group, resp
+    // is the answer to the gear groups query that checked it
+    void update_groups(uint8_t addr, uint8_t group, bool add, int resp);
+
+    // Configuration per short address, valid when its bit in _config_known
+    // is set
+    gear_config _config[64];
+    uint64_t _config_known;
+    // Physical minimum level per short address, 0 until queried
+    uint8_t _phm[64];
+
+    // Turn a wanted configuration into the values the gear at addr keeps
+    void normalise_config(uint8_t addr, gear_config &config);
+
+    // Queued configuration command, see begin_batch
+    struct batch_command {
+        uint8_t addr;
+        uint8_t opcode;
+        uint8_t value;
+    };
+
+    batch_command _batch[BATCH_MAX_COMMANDS];
+    uint8_t _batch_count;
+    uint8_t _batch_depth;
+
+    // Send opcode twice after loading value into DTR0, or queue it while a
+    // batch is open
+    void send_with_dtr0(uint8_t addr, uint8_t opcode, uint8_t value);
+
+    // Send the queued commands, one DTR0 load per value
+    void flush_batch();
+
+    // Send a DTR0 parameter command and keep the configuration cache in step
+    void set_config_value(uint8_t addr, ConfigField field, uint8_t value);
+
+    // Optional copy of the scene tables
+    DALISceneCache *_scene_cache;
+
+    // Driver side statistics, bus counters live in the encoder
+    dali_stats _stats;
+    // Innermost public call in progress
+    ApiScope *_scope;
 };
 
 #endif
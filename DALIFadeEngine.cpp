@@ -0,0 +1,198 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALIFadeEngine.h"
+
+DALIFadeEngine::DALIFadeEngine(DALIDriver &dali, uint32_t tick_ms,
+                               uint8_t bus_share)
+    : _dali(dali)
+{
+    _tick_us = tick_ms * 1000;
+    _next = 0;
+    set_bus_share(bus_share);
+    for (int i = 0; i < FADE_MAX_CHANNELS; i++) {
+        _channels[i].fade_time = -1;
+        _channels[i].active = false;
+    }
+}
+
+int DALIFadeEngine::find_channel(uint8_t addr)
+{
+    for (int i = 0; i < FADE_MAX_CHANNELS; i++) {
+        if (_channels[i].active && _channels[i].addr == addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool DALIFadeEngine::start_fade(uint8_t addr, uint8_t from, uint8_t to,
+                                uint32_t duration_ms)
+{
+    int i = find_channel(addr);
+    if (i < 0) {
+        for (i = 0; i < FADE_MAX_CHANNELS; i++) {
+            if (!_channels[i].active) {
+                break;
+            }
+        }
+        if (i == FADE_MAX_CHANNELS) {
+            return false;
+        }
+        // The gear would fade to every level streamed with its own fade
+        // time, lagging behind the fade
+        gear_config config;
+        _channels[i].fade_time = -1;
+        if (addr < 64 && _dali.get_config(addr, config) && config.fade_time) {
+            _dali.set_fade_time(addr, 0);
+            _channels[i].fade_time = config.fade_time;
+        }
+    }
+    fade_channel &ch = _channels[i];
+    ch.addr = addr;
+    ch.from = from;
+    ch.to = to;
+    ch.sent = -1;
+    ch.start_us = _dali.encoder.now_us();
+    ch.duration_us = duration_ms * 1000;
+    ch.active = true;
+    return true;
+}
+
+bool DALIFadeEngine::start_fade(uint8_t addr, uint8_t to,
+                                uint32_t duration_ms)
+{
+    uint8_t from = 0;
+    int i = find_channel(addr);
+    if (i >= 0) {
+        from = _channels[i].sent >= 0 ? _channels[i].sent : _channels[i].from;
+    } else if (!(addr & 0x80)) {
+        from = _dali.get_level(addr);
+    }
+    return start_fade(addr, from, to, duration_ms);
+}
+
+int DALIFadeEngine::finish(fade_channel &ch)
+{
+    ch.active = false;
+    if (ch.fade_time < 0) {
+        return 0;
+    }
+    uint32_t frames = _dali.encoder.get_frame_count();
+    _dali.set_fade_time(ch.addr, ch.fade_time);
+    ch.fade_time = -1;
+    return _dali.encoder.get_frame_count() - frames;
+}
+
+void DALIFadeEngine::cancel(uint8_t addr)
+{
+    int i = find_channel(addr);
+    if (i >= 0) {
+        finish(_channels[i]);
+    }
+}
+
+void DALIFadeEngine::cancel_all()
+{
+    for (int i = 0; i < FADE_MAX_CHANNELS; i++) {
+        if (_channels[i].active) {
+            finish(_channels[i]);
+        }
+    }
+}
+
+bool DALIFadeEngine::busy()
+{
+    for (int i = 0; i < FADE_MAX_CHANNELS; i++) {
+        if (_channels[i].active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DALIFadeEngine::set_bus_share(uint8_t bus_share)
+{
+    _bus_share = bus_share > 100 ? 100 : bus_share;
+}
+
+int DALIFadeEngine::get_frames_per_tick()
+{
+    // A DAPC occupies the bus for the frame and the settling time after it
+    uint32_t slot_us = _dali.encoder.frame_time_us(16) + 13500;
+    uint32_t frames = (uint64_t)_tick_us * _bus_share / 100 / slot_us;
+    // Always make progress, even with a tiny share
+    return frames ? frames : 1;
+}
+
+uint8_t DALIFadeEngine::level_at(const fade_channel &ch, uint32_t elapsed)
+{
+    if (elapsed >= ch.duration_us) {
+        return ch.to;
+    }
+    // Level 0 is off, fade between the lowest arc level and off at the end
+    int from = ch.from ? ch.from : 1;
+    int to = ch.to ? ch.to : 1;
+    int64_t step = (int64_t)(to - from) * elapsed;
+    // Round to the nearest level
+    int64_t half = ch.duration_us / 2;
+    step = step >= 0 ? (step + half) / ch.duration_us
+                     : (step - half) / (int64_t)ch.duration_us;
+    return from + (int)step;
+}
+
+int DALIFadeEngine::tick()
+{
+    int budget = get_frames_per_tick();
+    int sent = 0;
+    uint32_t now = _dali.encoder.now_us();
+    int first = -1;
+    for (int n = 0; n < FADE_MAX_CHANNELS && sent < budget; n++) {
+        int i = (_next + n) % FADE_MAX_CHANNELS;
+        fade_channel &ch = _channels[i];
+        if (!ch.active) {
+            continue;
+        }
+        uint32_t elapsed = now - ch.start_us;
+        uint8_t level = level_at(ch, elapsed);
+        if (level != ch.sent) {
+            _dali.send_command_direct(ch.addr, level);
+            ch.sent = level;
+            sent++;
+            first = i;
+        }
+        if (elapsed >= ch.duration_us && ch.sent == ch.to) {
+            sent += finish(ch);
+        }
+    }
+    // Start after the last channel served so every address gets its turn
+    if (first >= 0) {
+        _next = (first + 1) % FADE_MAX_CHANNELS;
+    }
+    return sent;
+}
+
+void DALIFadeEngine::run()
+{
+    while (busy()) {
+        uint32_t start = _dali.encoder.now_us();
+        tick();
+        uint32_t elapsed = _dali.encoder.now_us() - start;
+        if (elapsed < _tick_us) {
+            _dali.encoder.idle(_tick_us - elapsed);
+        }
+    }
+}
@@ -0,0 +1,147 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_FADE_ENGINE_H
+#define DALI_FADE_ENGINE_H
+
+#include "DALIDriver.h"
+
+// Addresses fading at the same time
+#define FADE_MAX_CHANNELS 16
+
+// One address being faded
+struct fade_channel {
+    // Short address, group address or broadcast_addr as for set_level
+    uint8_t addr;
+    uint8_t from;
+    uint8_t to;
+    // Level last sent to the bus, -1 before the first frame
+    int16_t sent;
+    uint32_t start_us;
+    uint32_t duration_us;
+    // Fade time the gear had before the fade, restored at the end, -1 when
+    // it was left alone
+    int8_t fade_time;
+    bool active;
+};
+
+/** Fades arc power levels by streaming DAPC frames from the driver
+ *
+ * Unlike the gear's fade time and fade rate tables a fade can take any
+ * duration, and fades on different addresses started together stay in step.
+ * The arc power levels follow the logarithmic dimming curve, so stepping the
+ * level linearly in time gives a perceptually even fade.
+ *
+ * All fades share one tick. Each tick sends at most one DAPC per address, only
+ * when its level changed, and no more frames than the configured share of the
+ * bus time. Addresses are served round robin when the share is too small for
+ * all of them. The last frame of a fade always carries the target level.
+ *
+ * Starting a fade on a short address sets its fade time to 0 so each DAPC
+ * takes effect at once, and the fade time is restored when the fade finishes
+ * or is cancelled. The fade time is taken from the driver's configuration
+ * cache, read from the gear when not cached. Groups and broadcast keep their
+ * fade time, set it to 0 on the members for a fade that follows exactly.
+ */
+class DALIFadeEngine {
+public:
+    /** Constructor DALIFadeEngine
+     *
+     *   @param dali         Driver used to send the frames
+     *   @param tick_ms      Time between updates
+     *   @param bus_share    Percent of the bus time the fades may use
+     */
+    DALIFadeEngine(DALIDriver &dali, uint32_t tick_ms = 100,
+                   uint8_t bus_share = 50);
+
+    /** Start fading an address, replaces a fade already running on it
+     *
+     *   Sets the fade time of a short address to 0 until the fade ends,
+     *   unless it is 0 already or a fade is running on it
+     *
+     *   @param addr         Address as for DALIDriver::set_level
+     *   @param from         Level to start from, sent on the first tick
+     *   @param to           Target level, 0 turns the gear off at the end
+     *   @param duration_ms  Length of the fade
+     *   @returns            false if all channels are in use
+     */
+    bool start_fade(uint8_t addr, uint8_t from, uint8_t to,
+                    uint32_t duration_ms);
+
+    /** Start fading an address from its current level
+     *
+     *   The level of a fade running on addr is used, otherwise the level is
+     *   queried from a short address and taken as 0 for groups and broadcast
+     *
+     *   @param addr         Address as for DALIDriver::set_level
+     *   @param to           Target level
+     *   @param duration_ms  Length of the fade
+     *   @returns            false if all channels are in use
+     */
+    bool start_fade(uint8_t addr, uint8_t to, uint32_t duration_ms);
+
+    /** Stop the fade on an address, leaving it at the last level sent
+     *
+     *   Restores the fade time of the address
+     */
+    void cancel(uint8_t addr);
+
+    /** Stop all fades
+     */
+    void cancel_all();
+
+    /** Check if any fade is running
+     */
+    bool busy();
+
+    /** Send the updates that are due
+     *
+     *   Call every tick_ms from thread context, the frames block while sent
+     *
+     *   @returns    Number of frames sent
+     */
+    int tick();
+
+    /** Tick until all fades are finished, idling the bus between ticks
+     */
+    void run();
+
+    /** Change the percent of the bus time the fades may use
+     */
+    void set_bus_share(uint8_t bus_share);
+
+    /** Get the number of DAPC frames each tick may send
+     */
+    int get_frames_per_tick();
+
+private:
+    int find_channel(uint8_t addr);
+
+    // Free a channel and restore the fade time, returns the frames sent
+    int finish(fade_channel &ch);
+
+    // Level the fade should be at after elapsed microseconds
+    uint8_t level_at(const fade_channel &ch, uint32_t elapsed);
+
+    DALIDriver &_dali;
+    uint32_t _tick_us;
+    uint8_t _bus_share;
+    // Channel to serve first on the next tick
+    int _next;
+    fade_channel _channels[FADE_MAX_CHANNELS];
+};
+
+#endif
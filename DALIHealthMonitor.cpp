@@ -0,0 +1,266 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALIHealthMonitor.h"
+
+DALIHealthMonitor::DALIHealthMonitor(DALIDriver &dali,
+                                     uint32_t min_interval_ms,
+                                     uint32_t max_interval_ms,
+                                     uint32_t idle_ms)
+    : _dali(dali)
+{
+    _min_interval_ms = min_interval_ms;
+    _max_interval_ms =
+        max_interval_ms > min_interval_ms ? max_interval_ms : min_interval_ms;
+    _idle_us = idle_ms * 1000;
+    _frames = bus_frames();
+    _busy_us = _dali.encoder.now_us();
+    _sweep_us = _busy_us;
+    memset(_devices, 0, sizeof(_devices));
+    rescan();
+}
+
+void DALIHealthMonitor::attach(mbed::Callback<void(health_event)> event_cb)
+{
+    _event_cb = event_cb;
+}
+
+void DALIHealthMonitor::rescan()
+{
+    uint32_t now = _dali.encoder.now_us();
+    uint64_t lights = _dali.get_light_addresses();
+    uint64_t inputs = _dali.get_input_addresses();
+    for (int addr = 0; addr < HEALTH_MAX_DEVICES; addr++) {
+        health_device &dev = _devices[addr];
+        uint64_t bit = (uint64_t)1 << addr;
+        bool input = (inputs & bit) != 0;
+        if (!(lights & bit) && !input) {
+            dev.watched = false;
+            continue;
+        }
+        if (dev.watched && dev.input == input) {
+            continue;
+        }
+        dev.watched = true;
+        dev.input = input;
+        dev.present = true;
+        dev.misses = 0;
+        dev.status = 0;
+        dev.instances = 0;
+        dev.polled = false;
+        dev.next_us = now;
+        dev.interval_ms = _min_interval_ms;
+    }
+}
+
+void DALIHealthMonitor::remap(uint8_t old_addr, uint8_t new_addr)
+{
+    if (old_addr >= HEALTH_MAX_DEVICES || new_addr >= HEALTH_MAX_DEVICES ||
+        old_addr == new_addr) {
+        return;
+    }
+    _devices[new_addr] = _devices[old_addr];
+    _devices[old_addr].watched = false;
+}
+
+void DALIHealthMonitor::forget(uint8_t addr)
+{
+    if (addr < HEALTH_MAX_DEVICES) {
+        _devices[addr].watched = false;
+    }
+}
+
+const health_device *DALIHealthMonitor::get_device(uint8_t addr)
+{
+    if (addr >= HEALTH_MAX_DEVICES || !_devices[addr].watched) {
+        return NULL;
+    }
+    return &_devices[addr];
+}
+
+uint32_t DALIHealthMonitor::bus_frames()
+{
+    return _dali.encoder.get_frame_count() +
+           _dali.encoder.get_received_count();
+}
+
+void DALIHealthMonitor::publish(uint8_t addr, HealthEventType type,
+                                uint8_t instance)
+{
+    if (_event_cb) {
+        health_event event = {addr, type, instance};
+        _event_cb(event);
+    }
+}
+
+void DALIHealthMonitor::schedule(health_device &dev, bool changed,
+                                 uint32_t now)
+{
+    if (changed) {
+        dev.interval_ms = _min_interval_ms;
+    } else if (dev.interval_ms < _max_interval_ms) {
+        dev.interval_ms = dev.interval_ms * 2 < _max_interval_ms
+                              ? dev.interval_ms * 2
+                              : _max_interval_ms;
+    }
+    dev.next_us = now + dev.interval_ms * 1000;
+}
+
+bool DALIHealthMonitor::missed(uint8_t addr, health_device &dev)
+{
+    if (!dev.present) {
+        return false;
+    }
+    if (++dev.misses < HEALTH_LOST_MISSES) {
+        // Poll again soon to tell a lost device from a missed answer
+        return true;
+    }
+    dev.present = false;
+    publish(addr, HEALTH_LOST);
+    return true;
+}
+
+bool DALIHealthMonitor::poll_gear(uint8_t addr, health_device &dev)
+{
+    _dali.send_command_standard(addr, QUERY_ERROR);
+    int resp = _dali.encoder.recv();
+    if (resp < 0) {
+        return missed(addr, dev);
+    }
+    dev.misses = 0;
+    bool changed = false;
+    if (!dev.present) {
+        dev.present = true;
+        publish(addr, HEALTH_FOUND);
+        changed = true;
+    }
+    uint8_t status = resp & 0x03;
+    uint8_t diff = status ^ dev.status;
+    dev.status = status;
+    if (diff & 0x01) {
+        publish(addr, status & 0x01 ? HEALTH_GEAR_FAILED
+                                    : HEALTH_GEAR_RECOVERED);
+    }
+    if (diff & 0x02) {
+        publish(addr, status & 0x02 ? HEALTH_LAMP_FAILED
+                                    : HEALTH_LAMP_RECOVERED);
+    }
+    return changed || diff;
+}
+
+bool DALIHealthMonitor::poll_input(uint8_t addr, health_device &dev)
+{
+    int count = _dali.query_instances(addr);
+    if (count < 0) {
+        return missed(addr, dev);
+    }
+    dev.misses = 0;
+    bool changed = false;
+    if (!dev.present) {
+        dev.present = true;
+        publish(addr, HEALTH_FOUND);
+        changed = true;
+    }
+    dev.instances = count < HEALTH_MAX_INSTANCES ? count : HEALTH_MAX_INSTANCES;
+    // Disabled instances do not answer, get_instance_status cannot tell
+    // that from YES
+    uint8_t status = 0;
+    for (int inst = 0; inst < dev.instances; inst++) {
+        _dali.send_command_standard_input(addr, inst, 0x86);
+        if (_dali.encoder.recv() >= 0) {
+            status |= 1 << inst;
+        }
+    }
+    uint8_t diff = status ^ dev.status;
+    dev.status = status;
+    if (!dev.polled) {
+        return changed;
+    }
+    for (int inst = 0; inst < HEALTH_MAX_INSTANCES; inst++) {
+        if (diff & (1 << inst)) {
+            publish(addr, status & (1 << inst) ? HEALTH_INSTANCE_ENABLED
+                                               : HEALTH_INSTANCE_DISABLED,
+                    inst);
+        }
+    }
+    return changed || diff;
+}
+
+bool DALIHealthMonitor::poll(uint8_t addr)
+{
+    health_device &dev = _devices[addr];
+    bool changed = dev.input ? poll_input(addr, dev) : poll_gear(addr, dev);
+    dev.polled = true;
+    return changed;
+}
+
+void DALIHealthMonitor::sweep(uint32_t now)
+{
+    _sweep_us = now + _min_interval_ms * 1000;
+    // One frame when no lamp failed
+    uint64_t failed = _dali.find_lamp_failures();
+    // Poll the gear whose lamp state differs from the last poll
+    for (int addr = 0; addr < HEALTH_MAX_DEVICES; addr++) {
+        health_device &dev = _devices[addr];
+        bool lamp_failed = (failed >> addr) & 1;
+        if (dev.watched && !dev.input && dev.present &&
+            lamp_failed != ((dev.status & 0x02) != 0)) {
+            dev.next_us = now;
+        }
+    }
+}
+
+int DALIHealthMonitor::tick(int max_polls)
+{
+    uint32_t now = _dali.encoder.now_us();
+    uint32_t frames = bus_frames();
+    if (frames != _frames) {
+        // The application or an input device used the bus since our last
+        // poll
+        _frames = frames;
+        _busy_us = now;
+    }
+    if (now - _busy_us < _idle_us) {
+        return 0;
+    }
+    int polls = 0;
+    if ((int32_t)(now - _sweep_us) >= 0) {
+        sweep(now);
+        polls++;
+    }
+    while (polls < max_polls) {
+        // Most overdue device first
+        int best = -1;
+        int32_t best_late = -1;
+        for (int addr = 0; addr < HEALTH_MAX_DEVICES; addr++) {
+            const health_device &dev = _devices[addr];
+            int32_t late = (int32_t)(now - dev.next_us);
+            if (dev.watched && late > best_late) {
+                best = addr;
+                best_late = late;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        bool changed = poll(best);
+        now = _dali.encoder.now_us();
+        schedule(_devices[best], changed, now);
+        polls++;
+    }
+    _frames = bus_frames();
+    return polls;
+}
@@ -0,0 +1,170 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_HEALTH_MONITOR_H
+#define DALI_HEALTH_MONITOR_H
+
+#include "DALIDriver.h"
+
+// Devices watched at the same time, one per short address
+#define HEALTH_MAX_DEVICES 64
+// Instances of an input device whose status is watched
+#define HEALTH_MAX_INSTANCES 8
+// Polls in a row without an answer before a device is lost, one missed or
+// collided answer is not enough
+#define HEALTH_LOST_MISSES 2
+
+enum HealthEventType {
+    // The device stopped answering
+    HEALTH_LOST,
+    // A lost device answers again
+    HEALTH_FOUND,
+    HEALTH_LAMP_FAILED,
+    HEALTH_LAMP_RECOVERED,
+    HEALTH_GEAR_FAILED,
+    HEALTH_GEAR_RECOVERED,
+    // An input device instance was enabled or disabled
+    HEALTH_INSTANCE_ENABLED,
+    HEALTH_INSTANCE_DISABLED
+};
+
+struct health_event {
+    uint8_t addr;
+    HealthEventType type;
+    // Instance number for the instance events, 0 otherwise
+    uint8_t instance;
+};
+
+// Last known state of one device
+struct health_device {
+    bool watched;
+    bool input;
+    bool present;
+    // Polls in a row the present device did not answer
+    uint8_t misses;
+    // Gear: QUERY STATUS bits 0 (gear failure) and 1 (lamp failure)
+    // Input device: bit n set when instance n is enabled
+    uint8_t status;
+    // Number of instances of an input device
+    uint8_t instances;
+    // Polled at least once, no events are published for the first poll of
+    // an input device
+    bool polled;
+    uint32_t next_us;
+    uint32_t interval_ms;
+};
+
+/** Watches the control gear and input devices on the bus in the background
+ *
+ * Each device is polled on its own schedule: right after a change it is
+ * polled at the shortest interval, and every poll without a change doubles
+ * the interval up to the longest one. A broadcast QUERY LAMP FAILURE at the
+ * shortest interval, narrowed down through groups when something answers,
+ * brings forward the gear whose lamp failed or recovered since its last
+ * poll when it is only polled slowly.
+ *
+ * Polls are only sent once the driver has not sent or received a frame for
+ * the configured time, so traffic of the application and events of input
+ * devices hold them back. The encoder does not see frames of other masters
+ * between our own receives. Only changes are published: a device getting
+ * lost or found, a lamp or gear failing or recovering, an input instance
+ * being enabled or disabled. A device is only lost after HEALTH_LOST_MISSES
+ * polls in a row without an answer, so a collided answer does not count.
+ */
+class DALIHealthMonitor {
+public:
+    /** Constructor DALIHealthMonitor
+     *
+     *   @param dali             Driver used to poll, after init
+     *   @param min_interval_ms  Poll interval after a change
+     *   @param max_interval_ms  Poll interval of stable devices
+     *   @param idle_ms          Bus idle time needed before polling
+     */
+    DALIHealthMonitor(DALIDriver &dali, uint32_t min_interval_ms = 1000,
+                      uint32_t max_interval_ms = 60000,
+                      uint32_t idle_ms = 100);
+
+    /** Publish changes to a callback
+     *
+     *   @param event_cb     Called from tick for every change
+     */
+    void attach(mbed::Callback<void(health_event)> event_cb);
+
+    /** Watch every light and input device the driver addressed
+     */
+    void rescan();
+
+    /** Follow a device that moved to another short address
+     *
+     *   @param old_addr     Address the device had
+     *   @param new_addr     Address it has now
+     */
+    void remap(uint8_t old_addr, uint8_t new_addr);
+
+    /** Stop watching a device
+     */
+    void forget(uint8_t addr);
+
+    /** Get the last known state of a device
+     *
+     *   @returns    NULL if the address is not watched
+     */
+    const health_device *get_device(uint8_t addr);
+
+    /** Poll the devices that are due, if the bus is idle
+     *
+     *   Call often from thread context, the frames block while sent
+     *
+     *   @param max_polls    Most devices polled by this call
+     *   @returns            Number of devices polled
+     */
+    int tick(int max_polls = 1);
+
+private:
+    // Poll one device and publish what changed, returns true on a change
+    bool poll(uint8_t addr);
+    bool poll_gear(uint8_t addr, health_device &dev);
+    bool poll_input(uint8_t addr, health_device &dev);
+    // Count a poll without an answer, the device is lost after
+    // HEALTH_LOST_MISSES in a row
+    bool missed(uint8_t addr, health_device &dev);
+
+    void publish(uint8_t addr, HealthEventType type, uint8_t instance = 0);
+
+    // Move the next poll of a device after a change or a quiet poll
+    void schedule(health_device &dev, bool changed, uint32_t now);
+
+    // Ask the whole bus for lamp failures and bring gear forward if needed
+    void sweep(uint32_t now);
+
+    // Frames the driver sent or received so far, other masters on the bus
+    // are not counted
+    uint32_t bus_frames();
+
+    DALIDriver &_dali;
+    uint32_t _min_interval_ms;
+    uint32_t _max_interval_ms;
+    uint32_t _idle_us;
+    // Driver frame count after our last poll and when the application or
+    // an input device last used the bus
+    uint32_t _frames;
+    uint32_t _busy_us;
+    uint32_t _sweep_us;
+    mbed::Callback<void(health_event)> _event_cb;
+    health_device _devices[HEALTH_MAX_DEVICES];
+};
+
+#endif
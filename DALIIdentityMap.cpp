@@ -0,0 +1,138 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALIIdentityMap.h"
+#include <string.h>
+
+DALIIdentityMap::DALIIdentityMap()
+{
+    clear();
+}
+
+void DALIIdentityMap::clear()
+{
+    _count = 0;
+}
+
+int DALIIdentityMap::index_of(uint8_t addr)
+{
+    for (int i = 0; i < _count; i++) {
+        if (_addrs[i] == addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int DALIIdentityMap::find(const dali_identity &id)
+{
+    for (int i = 0; i < _count; i++) {
+        if (!memcmp(&_ids[i], &id, sizeof(id))) {
+            return _addrs[i];
+        }
+    }
+    return -1;
+}
+
+bool DALIIdentityMap::reserved(uint8_t addr)
+{
+    return index_of(addr) >= 0;
+}
+
+bool DALIIdentityMap::get(uint8_t addr, dali_identity &id)
+{
+    int i = index_of(addr);
+    if (i < 0) {
+        return false;
+    }
+    id = _ids[i];
+    return true;
+}
+
+bool DALIIdentityMap::set(const dali_identity &id, uint8_t addr)
+{
+    // Whatever was at addr is gone, and the device moves there
+    forget_address(addr);
+    for (int i = 0; i < _count; i++) {
+        if (!memcmp(&_ids[i], &id, sizeof(id))) {
+            _addrs[i] = addr;
+            return true;
+        }
+    }
+    if (_count == IDENTITY_MAX_DEVICES) {
+        return false;
+    }
+    _ids[_count] = id;
+    _addrs[_count] = addr;
+    _count++;
+    return true;
+}
+
+void DALIIdentityMap::forget_address(uint8_t addr)
+{
+    for (int i = 0; i < _count; i++) {
+        if (_addrs[i] == addr) {
+            _count--;
+            _ids[i] = _ids[_count];
+            _addrs[i] = _addrs[_count];
+            i--;
+        }
+    }
+}
+
+size_t DALIIdentityMap::save(uint8_t *buf, size_t size)
+{
+    size_t needed = IDENTITY_HEADER_SIZE + _count * IDENTITY_ENTRY_SIZE;
+    if (size < needed) {
+        return 0;
+    }
+    memcpy(buf, IDENTITY_MAGIC, 4);
+    buf[4] = IDENTITY_VERSION;
+    buf[5] = 0;
+    buf[6] = _count & 0xFF;
+    buf[7] = _count >> 8;
+    uint8_t *entry = buf + IDENTITY_HEADER_SIZE;
+    for (int i = 0; i < _count; i++) {
+        entry[0] = _addrs[i];
+        memcpy(entry + 1, _ids[i].gtin, sizeof(_ids[i].gtin));
+        memcpy(entry + 7, _ids[i].serial, sizeof(_ids[i].serial));
+        entry += IDENTITY_ENTRY_SIZE;
+    }
+    return needed;
+}
+
+bool DALIIdentityMap::load(const uint8_t *buf, size_t size)
+{
+    clear();
+    if (size < IDENTITY_HEADER_SIZE || memcmp(buf, IDENTITY_MAGIC, 4) ||
+        buf[4] != IDENTITY_VERSION) {
+        return false;
+    }
+    int count = buf[6] | (buf[7] << 8);
+    if (count > IDENTITY_MAX_DEVICES ||
+        size < IDENTITY_HEADER_SIZE + (size_t)count * IDENTITY_ENTRY_SIZE) {
+        return false;
+    }
+    const uint8_t *entry = buf + IDENTITY_HEADER_SIZE;
+    for (int i = 0; i < count; i++) {
+        dali_identity id;
+        memcpy(id.gtin, entry + 1, sizeof(id.gtin));
+        memcpy(id.serial, entry + 7, sizeof(id.serial));
+        set(id, entry[0]);
+        entry += IDENTITY_ENTRY_SIZE;
+    }
+    return true;
+}
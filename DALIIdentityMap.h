@@ -0,0 +1,107 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_IDENTITY_MAP_H
+#define DALI_IDENTITY_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IDENTITY_MAX_DEVICES 64
+
+// Saved map: 8 byte header ("DAID", version, reserved, count as uint16
+// little endian) followed by the entries, short address, GTIN and serial
+#define IDENTITY_MAGIC "DAID"
+#define IDENTITY_VERSION 1
+#define IDENTITY_HEADER_SIZE 8
+#define IDENTITY_ENTRY_SIZE 15
+#define IDENTITY_SAVE_SIZE                                                    \
+    (IDENTITY_HEADER_SIZE + IDENTITY_MAX_DEVICES * IDENTITY_ENTRY_SIZE)
+
+// Identity of a control gear from memory bank 0, see iec62386-102 9.10.6
+struct dali_identity {
+    // Global trade item number, MSB first
+    uint8_t gtin[6];
+    // Identification number, MSB first
+    uint8_t serial[8];
+};
+
+/** Short addresses of control gear by identity
+ *
+ * Attached with DALIDriver::set_identity_map, commissioning gives a device
+ * found again the short address it had, as long as no other device took it
+ * in the meantime. The map is meant to be saved to non-volatile storage
+ * after commissioning and loaded at boot.
+ */
+class DALIIdentityMap {
+public:
+    DALIIdentityMap();
+
+    /** Forget every device
+     */
+    void clear();
+
+    /** Get the short address of a device
+     *
+     *   @returns    the address, -1 for a device not in the map
+     */
+    int find(const dali_identity &id);
+
+    /** Check if a short address belongs to a device in the map
+     */
+    bool reserved(uint8_t addr);
+
+    /** Get the device at a short address
+     *
+     *   @returns    false if no device in the map has the address
+     */
+    bool get(uint8_t addr, dali_identity &id);
+
+    /** Record the short address of a device, replacing any other device at
+     * that address
+     *
+     *   @returns    false if the map is full
+     */
+    bool set(const dali_identity &id, uint8_t addr);
+
+    /** Forget the device at a short address
+     */
+    void forget_address(uint8_t addr);
+
+    /** Write the map to a buffer
+     *
+     *   @param buf      at least IDENTITY_SAVE_SIZE bytes to be sure
+     *   @param size     size of buf
+     *   @returns        bytes written, 0 if buf is too small
+     */
+    size_t save(uint8_t *buf, size_t size);
+
+    /** Replace the map with one written by save
+     *
+     *   @returns    false if buf does not hold a saved map, the map is left
+     * empty then
+     */
+    bool load(const uint8_t *buf, size_t size);
+
+private:
+    int index_of(uint8_t addr);
+
+    dali_identity _ids[IDENTITY_MAX_DEVICES];
+    uint8_t _addrs[IDENTITY_MAX_DEVICES];
+    int _count;
+};
+
+#endif
@@ -0,0 +1,180 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALIPlanner.h"
+
+DALIPlanner::DALIPlanner(DALIDriver &dali) : _dali(dali)
+{
+}
+
+int DALIPlanner::find_scene(const uint8_t *targets, uint64_t lights)
+{
+    DALISceneCache *cache = _dali.get_scene_cache();
+    if (!cache) {
+        return -1;
+    }
+    for (int scene = 0; scene < SCENE_COUNT; scene++) {
+        bool match = true;
+        for (int addr = 0; addr < 64 && match; addr++) {
+            if (!(lights & ((uint64_t)1 << addr))) {
+                continue;
+            }
+            // Lights to keep must not be part of the scene
+            uint8_t want = targets[addr] == PLAN_KEEP ? DALI_MASK
+                                                      : targets[addr];
+            match = cache->known(addr, scene) &&
+                    cache->get(addr, scene).level == want;
+        }
+        if (match) {
+            return scene;
+        }
+    }
+    return -1;
+}
+
+int DALIPlanner::plan(const uint8_t *targets, plan_step *steps)
+{
+    uint64_t lights = _dali.get_light_addresses();
+    // One past the highest light address
+    int num = 64;
+    while (num && !(lights & ((uint64_t)1 << (num - 1)))) {
+        num--;
+    }
+
+    int scene = find_scene(targets, lights);
+    if (scene >= 0) {
+        steps[0].command = PLAN_SCENE;
+        steps[0].addr = DALIDriver::broadcast_addr;
+        steps[0].level = scene;
+        return 1;
+    }
+
+    // Members of each group, bit 16 stands for broadcast. Lights whose
+    // groups cannot be read may be in any group.
+    uint64_t members[17];
+    uint64_t keep = 0;
+    uint64_t unknown = 0;
+    memset(members, 0, sizeof(members));
+    for (int addr = 0; addr < num; addr++) {
+        uint64_t bit = (uint64_t)1 << addr;
+        if (!(lights & bit)) {
+            continue;
+        }
+        members[16] |= bit;
+        if (targets[addr] == PLAN_KEEP) {
+            keep |= bit;
+        }
+        uint16_t groups;
+        if (!_dali.get_groups(addr, groups)) {
+            unknown |= bit;
+            continue;
+        }
+        for (int g = 0; g < 16; g++) {
+            if (groups & (1 << g)) {
+                members[g] |= bit;
+            }
+        }
+    }
+
+    // Planned level of each light, -1 until a command reaches it
+    int state[64];
+    for (int addr = 0; addr < num; addr++) {
+        state[addr] = -1;
+    }
+    int n = 0;
+    while (true) {
+        int best_gain = 1;
+        int best_group = -1;
+        uint8_t best_level = 0;
+        for (int g = 0; g <= 16; g++) {
+            if (!members[g] || (members[g] & keep) ||
+                (g < 16 && unknown)) {
+                continue;
+            }
+            // Try the level most members want
+            int count[256];
+            memset(count, 0, sizeof(count));
+            for (int addr = 0; addr < num; addr++) {
+                if (members[g] & ((uint64_t)1 << addr)) {
+                    count[targets[addr]]++;
+                }
+            }
+            int level = 0;
+            for (int l = 1; l < 255; l++) {
+                if (count[l] > count[level]) {
+                    level = l;
+                }
+            }
+            // Lights it corrects minus lights it breaks
+            int gain = 0;
+            for (int addr = 0; addr < num; addr++) {
+                if (!(members[g] & ((uint64_t)1 << addr))) {
+                    continue;
+                }
+                bool right = state[addr] == targets[addr];
+                if (targets[addr] == level && !right) {
+                    gain++;
+                } else if (targets[addr] != level && right) {
+                    gain--;
+                }
+            }
+            if (gain > best_gain) {
+                best_gain = gain;
+                best_group = g;
+                best_level = level;
+            }
+        }
+        if (best_group < 0) {
+            break;
+        }
+        steps[n].command = PLAN_LEVEL;
+        steps[n].addr = best_group == 16 ? DALIDriver::broadcast_addr
+                                         : _dali.get_group_addr(best_group);
+        steps[n].level = best_level;
+        n++;
+        for (int addr = 0; addr < num; addr++) {
+            if (members[best_group] & ((uint64_t)1 << addr)) {
+                state[addr] = best_level;
+            }
+        }
+    }
+
+    for (int addr = 0; addr < num; addr++) {
+        if ((lights & ((uint64_t)1 << addr)) && targets[addr] != PLAN_KEEP &&
+            state[addr] != targets[addr]) {
+            steps[n].command = PLAN_LEVEL;
+            steps[n].addr = addr;
+            steps[n].level = targets[addr];
+            n++;
+        }
+    }
+    return n;
+}
+
+int DALIPlanner::apply(const uint8_t *targets)
+{
+    plan_step steps[PLAN_MAX_STEPS];
+    int n = plan(targets, steps);
+    for (int i = 0; i < n; i++) {
+        if (steps[i].command == PLAN_SCENE) {
+            _dali.send_command_standard(steps[i].addr,
+                                        GO_TO_SCENE + steps[i].level);
+        } else {
+            _dali.send_command_direct(steps[i].addr, steps[i].level);
+        }
+    }
+    return n;
+}
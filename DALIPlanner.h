@@ -0,0 +1,85 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_PLANNER_H
+#define DALI_PLANNER_H
+
+#include "DALIDriver.h"
+
+// Target level for lights whose level must not change
+#define PLAN_KEEP 0xFF
+
+// Most commands a plan can hold: broadcast, 16 groups, 64 short addresses
+#define PLAN_MAX_STEPS 81
+
+enum PlanCommand {
+    // DAPC with level to addr
+    PLAN_LEVEL,
+    // Recall scene level to addr
+    PLAN_SCENE
+};
+
+// One command of a plan, sent in order so later steps override earlier ones
+struct plan_step {
+    PlanCommand command;
+    // Short, group or broadcast address
+    uint8_t addr;
+    // Arc power level for PLAN_LEVEL, scene number for PLAN_SCENE
+    uint8_t level;
+};
+
+/** Finds few commands that bring the lights to per light target levels
+ *
+ * A scene whose cached levels match all targets is recalled with one
+ * broadcast. Otherwise the planner picks broadcast and group DAPC commands
+ * greedily, each time the one that corrects the most lights, and finishes
+ * with short address commands for the lights still wrong. Groups and
+ * broadcast are only used when none of their members must keep its level.
+ */
+class DALIPlanner {
+public:
+    /** Constructor DALIPlanner
+     *
+     *   @param dali     Driver, its group cache (and scene cache when set)
+     * describes the bus
+     */
+    DALIPlanner(DALIDriver &dali);
+
+    /** Plan the commands for target levels
+     *
+     *   Group membership not yet cached is read from the bus
+     *
+     *   @param targets  Level per short address up to the highest light
+     * address, PLAN_KEEP for lights to leave alone
+     *   @param steps    Filled with the commands
+     *   @returns        Number of steps
+     */
+    int plan(const uint8_t *targets, plan_step *steps);
+
+    /** Plan and send the commands for target levels
+     *
+     *   @returns    Number of frames sent
+     */
+    int apply(const uint8_t *targets);
+
+private:
+    // Scene whose cached levels of lights match targets, -1 if none
+    int find_scene(const uint8_t *targets, uint64_t lights);
+
+    DALIDriver &_dali;
+};
+
+#endif
@@ -0,0 +1,94 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALIReplay.h"
+
+DALIReplay::DALIReplay(const replay_frame *frames, int num_frames)
+    : _frames(frames), _num_frames(num_frames)
+{
+    rewind();
+}
+
+int DALIReplay::from_trace(const trace_record *records, int num_records,
+                           replay_frame *frames, int max_frames)
+{
+    int n = 0;
+    for (int i = 0; i < num_records; i++) {
+        const trace_record &r = records[i];
+        if (trace_direction(r) == TRACE_FORWARD) {
+            if (n == max_frames) {
+                break;
+            }
+            frames[n].forward = trace_data(r);
+            frames[n].bits = trace_width(r);
+            frames[n].backward = -1;
+            n++;
+        } else if (n > 0 && trace_width(r) == 8 &&
+                   trace_status(r) != TRACE_NO_ANSWER) {
+            // Answer to the last forward frame, 24 bit events are dropped
+            frames[n - 1].backward = trace_data(r);
+        }
+    }
+    return n;
+}
+
+void DALIReplay::rewind()
+{
+    _pos = 0;
+    _mismatches = 0;
+    _first_mismatch = -1;
+    _extra = 0;
+}
+
+void DALIReplay::get_report(replay_report &report)
+{
+    int replayed = _pos < _num_frames ? _pos : _num_frames;
+    report.frames = replayed + _extra;
+    report.mismatches = _mismatches;
+    report.first_mismatch = _first_mismatch;
+    report.missing = _num_frames - replayed;
+    report.extra = _extra;
+}
+
+bool DALIReplay::matched()
+{
+    return _mismatches == 0 && _extra == 0 && _pos == _num_frames;
+}
+
+void DALIReplay::forward(uint32_t data, int bits)
+{
+    if (_pos >= _num_frames) {
+        _extra++;
+        return;
+    }
+    const replay_frame &f = _frames[_pos];
+    if (f.forward != data || f.bits != bits) {
+        if (_first_mismatch < 0) {
+            _first_mismatch = _pos;
+        }
+        _mismatches++;
+    }
+    // Stay in lockstep with the recording after a mismatch
+    _pos++;
+}
+
+int DALIReplay::backward()
+{
+    if (_pos == 0 || _extra) {
+        return -1;
+    }
+    return _frames[_pos - 1].backward;
+}
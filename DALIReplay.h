@@ -0,0 +1,98 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_REPLAY_H
+#define DALI_REPLAY_H
+
+#include "manchester/bus_model.h"
+#include "manchester/trace.h"
+
+// One recorded forward frame and the answer that followed it
+struct replay_frame {
+    uint32_t forward;
+    // Width of the forward frame, 16 or 24
+    uint8_t bits;
+    // Backward frame, -1 when nothing answered
+    int16_t backward;
+};
+
+struct replay_report {
+    // Forward frames the driver sent
+    uint32_t frames;
+    // Sent frames that differ from the recording
+    uint32_t mismatches;
+    // Index of the first differing frame, -1 if none
+    int first_mismatch;
+    // Recorded frames the driver did not send
+    uint32_t missing;
+    // Frames sent after the end of the recording
+    uint32_t extra;
+};
+
+// Bus model answering the driver from recorded traffic, for regression runs
+// without hardware. Attach it with ManchesterEncoder::set_bus_model and read
+// the frame cost and simulated bus time per call from DALIDriver::get_stats.
+class DALIReplay : public BusModel {
+public:
+    /** Constructor DALIReplay
+     *
+     *   @param frames       Recorded frames, must outlive the replay
+     *   @param num_frames   Number of recorded frames
+     */
+    DALIReplay(const replay_frame *frames, int num_frames);
+
+    /** Convert a frame trace into a recording
+     *
+     *   @param records      Trace records, oldest first
+     *   @param num_records  Number of trace records
+     *   @param frames       Filled with the recorded frames
+     *   @param max_frames   Size of frames
+     *   @returns            Number of frames written
+     */
+    static int from_trace(const trace_record *records, int num_records,
+                          replay_frame *frames, int max_frames);
+
+    /** Start again from the first recorded frame and clear the report
+     */
+    void rewind();
+
+    /** Compare what the driver sent so far with the recording
+     *
+     *   @param report   Filled with the comparison
+     */
+    void get_report(replay_report &report);
+
+    /** Check the driver sent exactly the recorded frames
+     *
+     *   @returns    true if every recorded frame was sent and nothing else
+     */
+    bool matched();
+
+    virtual void forward(uint32_t data, int bits);
+
+    virtual int backward();
+
+private:
+    const replay_frame *_frames;
+    int _num_frames;
+    // Next recorded frame
+    int _pos;
+    uint32_t _mismatches;
+    int _first_mismatch;
+    uint32_t _extra;
+};
+
+#endif
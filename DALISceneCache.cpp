@@ -0,0 +1,101 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALISceneCache.h"
+#include <string.h>
+
+DALISceneCache::DALISceneCache()
+{
+    clear();
+}
+
+void DALISceneCache::clear()
+{
+    memset(_entries, 0, sizeof(_entries));
+    memset(_known, 0, sizeof(_known));
+}
+
+bool DALISceneCache::known(uint8_t addr, uint8_t scene)
+{
+    if (addr >= SCENE_CACHE_ADDRS || scene >= SCENE_COUNT) {
+        return false;
+    }
+    return (_known[addr] >> scene) & 0x01;
+}
+
+const scene_entry &DALISceneCache::get(uint8_t addr, uint8_t scene)
+{
+    return _entries[addr % SCENE_CACHE_ADDRS][scene % SCENE_COUNT];
+}
+
+void DALISceneCache::set_level(uint8_t addr, uint8_t scene, uint8_t level)
+{
+    scene_entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.level = level;
+    entry.color_type = SCENE_COLOR_UNKNOWN;
+    set(addr, scene, entry);
+}
+
+void DALISceneCache::set(uint8_t addr, uint8_t scene,
+                         const scene_entry &entry)
+{
+    if (scene >= SCENE_COUNT) {
+        return;
+    }
+    if (addr >= 0xFE) {
+        for (int i = 0; i < SCENE_CACHE_ADDRS; i++) {
+            _entries[i][scene] = entry;
+            _known[i] |= 1 << scene;
+        }
+    } else if (addr < SCENE_CACHE_ADDRS) {
+        _entries[addr][scene] = entry;
+        _known[addr] |= 1 << scene;
+    } else {
+        forget(addr, scene);
+    }
+}
+
+void DALISceneCache::forget(uint8_t addr, uint8_t scene)
+{
+    if (scene >= SCENE_COUNT) {
+        return;
+    }
+    if (addr < SCENE_CACHE_ADDRS) {
+        _known[addr] &= ~(1 << scene);
+        return;
+    }
+    for (int i = 0; i < SCENE_CACHE_ADDRS; i++) {
+        _known[i] &= ~(1 << scene);
+    }
+}
+
+void DALISceneCache::forget_address(uint8_t addr)
+{
+    if (addr < SCENE_CACHE_ADDRS) {
+        _known[addr] = 0;
+    }
+}
+
+void DALISceneCache::move_address(uint8_t from, uint8_t to)
+{
+    if (from >= SCENE_CACHE_ADDRS || to >= SCENE_CACHE_ADDRS || from == to) {
+        return;
+    }
+    memcpy(_entries[to], _entries[from], sizeof(_entries[to]));
+    _known[to] = _known[from];
+    _known[from] = 0;
+}
@@ -0,0 +1,113 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_SCENE_CACHE_H
+#define DALI_SCENE_CACHE_H
+
+#include "DALICommands.h"
+#include <stdint.h>
+
+#define SCENE_CACHE_ADDRS 64
+#define SCENE_COUNT 16
+
+enum SceneColorType {
+    SCENE_COLOR_UNKNOWN,
+    // The scene does not change the colour
+    SCENE_COLOR_NONE,
+    SCENE_COLOR_TEMPERATURE,
+    SCENE_COLOR_RGB
+};
+
+// One scene of one light
+struct scene_entry {
+    // Arc power level, DALI_MASK when the light is not part of the scene
+    uint8_t level;
+    // SceneColorType
+    uint8_t color_type;
+    // Mirek (LSB first) for SCENE_COLOR_TEMPERATURE, r, g, b and dim for
+    // SCENE_COLOR_RGB
+    uint8_t color[4];
+};
+
+/** Copy of the scene tables of the lights on the bus
+ *
+ * The driver keeps it up to date for the scenes it writes once attached
+ * with DALIDriver::set_scene_cache. Scenes written to groups are forgotten
+ * for every light, group membership is not known here.
+ */
+class DALISceneCache {
+public:
+    DALISceneCache();
+
+    /** Forget every scene of every light
+     */
+    void clear();
+
+    /** Check if the level of a scene is known
+     *
+     *   @param addr     Short address
+     *   @param scene    Scene number [0,15]
+     */
+    bool known(uint8_t addr, uint8_t scene);
+
+    /** Get a cached scene, only valid when known
+     */
+    const scene_entry &get(uint8_t addr, uint8_t scene);
+
+    /** Record the level of a scene, its colour becomes unknown
+     *
+     *   @param addr     Short address or broadcast, a group forgets the scene
+     * of every light
+     *   @param scene    Scene number [0,15]
+     *   @param level    Level, DALI_MASK removes the light from the scene
+     */
+    void set_level(uint8_t addr, uint8_t scene, uint8_t level);
+
+    /** Record the level and colour of a scene
+     *
+     *   @param addr     Short address or broadcast, a group forgets the scene
+     * of every light
+     *   @param scene    Scene number [0,15]
+     *   @param entry    Level and colour of the scene
+     */
+    void set(uint8_t addr, uint8_t scene, const scene_entry &entry);
+
+    /** Forget a scene
+     *
+     *   @param addr     Short address, a group or broadcast forgets the scene
+     * of every light
+     *   @param scene    Scene number [0,15]
+     */
+    void forget(uint8_t addr, uint8_t scene);
+
+    /** Forget every scene of a light
+     */
+    void forget_address(uint8_t addr);
+
+    /** Move the scenes of a light to another short address
+     *
+     *   @param from     Old short address, forgotten afterwards
+     *   @param to       New short address, its scenes are replaced
+     */
+    void move_address(uint8_t from, uint8_t to);
+
+private:
+    scene_entry _entries[SCENE_CACHE_ADDRS][SCENE_COUNT];
+    // Bit n set when scene n is known
+    uint16_t _known[SCENE_CACHE_ADDRS];
+};
+
+#endif
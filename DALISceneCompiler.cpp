@@ -0,0 +1,136 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALISceneCompiler.h"
+
+DALISceneCompiler::DALISceneCompiler(DALIDriver &dali, DALISceneCache &cache)
+    : _dali(dali), _cache(cache)
+{
+    _dali.set_scene_cache(&_cache);
+}
+
+void DALISceneCompiler::make_entry(const light_state &state,
+                                   scene_entry &entry)
+{
+    memset(&entry, 0, sizeof(entry));
+    entry.level = state.level;
+    if (state.color == TEMPERATURE) {
+        // As sent, clamped to the limits of the light
+        uint16_t mirek = _dali.temp_to_mirek(state.addr, state.temp);
+        entry.color_type = SCENE_COLOR_TEMPERATURE;
+        entry.color[0] = mirek & 0x00FF;
+        entry.color[1] = mirek >> 8;
+    } else if (state.color == RGB) {
+        entry.color_type = SCENE_COLOR_RGB;
+        entry.color[0] = state.rgb.r;
+        entry.color[1] = state.rgb.g;
+        entry.color[2] = state.rgb.b;
+        entry.color[3] = state.rgb.dim;
+    } else {
+        entry.color_type = SCENE_COLOR_UNKNOWN;
+    }
+}
+
+bool DALISceneCompiler::cached(uint8_t addr, uint8_t scene,
+                               const scene_entry &entry)
+{
+    if (!_cache.known(addr, scene)) {
+        return false;
+    }
+    const scene_entry &old = _cache.get(addr, scene);
+    if (old.level != entry.level) {
+        return false;
+    }
+    // Level only states accept any colour
+    if (entry.color_type == SCENE_COLOR_UNKNOWN) {
+        return true;
+    }
+    return old.color_type == entry.color_type &&
+           memcmp(old.color, entry.color, sizeof(old.color)) == 0;
+}
+
+int DALISceneCompiler::compile(uint8_t scene, const light_state *states,
+                               uint8_t n, bool exclude_others)
+{
+    scene_entry entries[SCENE_CACHE_ADDRS];
+    // Index of the state of each address, -1 when not taking part
+    int16_t state_of[SCENE_CACHE_ADDRS];
+    bool dirty[SCENE_CACHE_ADDRS];
+    memset(state_of, -1, sizeof(state_of));
+    memset(dirty, 0, sizeof(dirty));
+
+    for (int i = 0; i < n; i++) {
+        uint8_t addr = states[i].addr;
+        if (addr >= SCENE_CACHE_ADDRS) {
+            continue;
+        }
+        state_of[addr] = i;
+        make_entry(states[i], entries[addr]);
+        dirty[addr] = !cached(addr, scene, entries[addr]);
+    }
+
+    // Colours go to the temporary colour of each light first, SET_SCENE
+    // stores them with the level
+    for (int addr = 0; addr < SCENE_CACHE_ADDRS; addr++) {
+        if (!dirty[addr]) {
+            continue;
+        }
+        const light_state &state = states[state_of[addr]];
+        if (state.color == TEMPERATURE) {
+            _dali.stage_color(addr, state.temp);
+        } else if (state.color == RGB) {
+            _dali.stage_color(addr, state.rgb.r, state.rgb.g, state.rgb.b,
+                              state.rgb.dim);
+        }
+    }
+
+    // The driver batch shares one DTR0 load per level
+    int written = 0;
+    _dali.begin_batch();
+    for (int addr = 0; addr < SCENE_CACHE_ADDRS; addr++) {
+        if (!dirty[addr]) {
+            continue;
+        }
+        _dali.set_scene(addr, scene, entries[addr].level);
+        written++;
+    }
+    _dali.end_batch();
+    for (int addr = 0; addr < SCENE_CACHE_ADDRS; addr++) {
+        if (dirty[addr]) {
+            _cache.set(addr, scene, entries[addr]);
+        }
+    }
+
+    if (!exclude_others) {
+        return written;
+    }
+    uint64_t lights = _dali.get_light_addresses();
+    for (int addr = 0; addr < 64; addr++) {
+        if (!(lights & ((uint64_t)1 << addr)) || state_of[addr] >= 0 ||
+            (_cache.known(addr, scene) &&
+             _cache.get(addr, scene).level == DALI_MASK)) {
+            continue;
+        }
+        _dali.remove_from_scene(addr, scene);
+        written++;
+    }
+    return written;
+}
+
+void DALISceneCompiler::recall(uint8_t scene)
+{
+    _dali.go_to_scene(DALIDriver::broadcast_addr, scene);
+}
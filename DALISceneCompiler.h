@@ -0,0 +1,79 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_SCENE_COMPILER_H
+#define DALI_SCENE_COMPILER_H
+
+#include "DALIDriver.h"
+
+// Desired state of one light
+struct light_state {
+    // Short address
+    uint8_t addr;
+    // Arc power level [0,254]
+    uint8_t level;
+    // TEMPERATURE or RGB, UNSUPPORTED leaves the colour alone
+    ColorType color;
+    // Colour temperature in Kelvin for TEMPERATURE
+    uint16_t temp;
+    // Colour for RGB
+    dali_rgb rgb;
+};
+
+/** Turns a lighting state for the whole bus into a scene
+ *
+ * compile() writes only the scene entries that differ from the scene cache,
+ * sharing one DTR0 load between all lights with the same level. Afterwards
+ * recall() shows the whole state with one broadcast, however many lights
+ * take part.
+ */
+class DALISceneCompiler {
+public:
+    /** Constructor DALISceneCompiler
+     *
+     *   @param dali     Driver used to write the scenes
+     *   @param cache    Scene tables of the bus, also set on the driver
+     */
+    DALISceneCompiler(DALIDriver &dali, DALISceneCache &cache);
+
+    /** Store a lighting state as a scene
+     *
+     *   @param scene            Scene number [0,15]
+     *   @param states           Desired state of each light taking part
+     *   @param n                Number of states
+     *   @param exclude_others   Remove the other addressed lights from the
+     * scene so a recall leaves them alone
+     *   @returns                Number of scene entries written
+     */
+    int compile(uint8_t scene, const light_state *states, uint8_t n,
+                bool exclude_others = true);
+
+    /** Show a compiled scene on all lights at once
+     */
+    void recall(uint8_t scene);
+
+private:
+    // Scene entry a state compiles to
+    void make_entry(const light_state &state, scene_entry &entry);
+
+    // Check if the cache already holds the entry
+    bool cached(uint8_t addr, uint8_t scene, const scene_entry &entry);
+
+    DALIDriver &_dali;
+    DALISceneCache &_cache;
+};
+
+#endif
@@ -0,0 +1,623 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DALISimBus.h"
+#include <string.h>
+
+#define SIM_YES 0xFF
+#define SIM_MASK 0xFF
+
+DALISimBus::DALISimBus()
+{
+    reset(0, 0, 0, SIM_RANDOM_UNIFORM);
+}
+
+void DALISimBus::reset(int gear_count, int input_count, int instances,
+                       SimRandomMode mode, uint32_t seed)
+{
+    num_gear = gear_count > SIM_MAX_GEAR ? SIM_MAX_GEAR : gear_count;
+    num_inputs = input_count > SIM_MAX_INPUTS ? SIM_MAX_INPUTS : input_count;
+    if (instances > SIM_MAX_INSTANCES) {
+        instances = SIM_MAX_INSTANCES;
+    }
+    _mode = mode;
+    // xorshift needs a non-zero state
+    _seed = seed ? seed : 1;
+    _random_base = 0;
+    _search_addr = 0xFFFFFF;
+    _input_search_addr = 0xFFFFFF;
+    _device_type = -1;
+    _answer = -1;
+    _next_serial = 1;
+
+    for (int i = 0; i < num_gear; i++) {
+        init_gear(gear[i]);
+    }
+    for (int i = 0; i < num_inputs; i++) {
+        init_input(inputs[i], instances);
+    }
+}
+
+void DALISimBus::init_gear(sim_gear &g)
+{
+    memset(&g, 0, sizeof(g));
+    g.short_addr = SIM_MASK;
+    g.random_addr = 0xFFFFFF;
+    g.init_state = SIM_DISABLED;
+    g.level = 254;
+    memset(g.scenes, SIM_MASK, sizeof(g.scenes));
+    g.fade = 0x07;
+    g.min_level = 1;
+    g.max_level = 254;
+    g.power_on_level = 254;
+    g.failure_level = 254;
+    g.phm = 1;
+    g.bank0[0x00] = sizeof(g.bank0) - 1;
+    // Same product for all, a serial number per device
+    static const uint8_t gtin[6] = {0x00, 0x87, 0x18, 0x69, 0x00, 0x42};
+    memcpy(&g.bank0[0x03], gtin, sizeof(gtin));
+    uint32_t serial = _next_serial++;
+    for (int i = 0; i < 4; i++) {
+        g.bank0[0x12 - i] = (serial >> (8 * i)) & 0xFF;
+    }
+}
+
+void DALISimBus::init_input(sim_input &d, int instances)
+{
+    // Occupancy, light and button instances in turn
+    static const uint8_t types[] = {3, 4, 1};
+    memset(&d, 0, sizeof(d));
+    d.short_addr = SIM_MASK;
+    d.random_addr = 0xFFFFFF;
+    d.init_state = SIM_DISABLED;
+    d.num_instances = instances;
+    for (int j = 0; j < instances; j++) {
+        d.instance_type[j] = types[j % 3];
+    }
+}
+
+int DALISimBus::plug_gear()
+{
+    if (num_gear == SIM_MAX_GEAR) {
+        return -1;
+    }
+    init_gear(gear[num_gear]);
+    return num_gear++;
+}
+
+int DALISimBus::plug_input(int instances)
+{
+    if (num_inputs == SIM_MAX_INPUTS) {
+        return -1;
+    }
+    if (instances > SIM_MAX_INSTANCES) {
+        instances = SIM_MAX_INSTANCES;
+    }
+    init_input(inputs[num_inputs], instances);
+    return num_inputs++;
+}
+
+int DALISimBus::backward()
+{
+    return _answer;
+}
+
+uint32_t DALISimBus::next_random(int index)
+{
+    // xorshift32
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    switch (_mode) {
+        case SIM_RANDOM_CLUSTERED:
+            return (_random_base + (_seed & 0xFFF)) & 0xFFFFFF;
+        case SIM_RANDOM_ADJACENT:
+            return (_random_base + index) & 0xFFFFFF;
+        default:
+            return _seed & 0xFFFFFF;
+    }
+}
+
+void DALISimBus::answer(int value)
+{
+    // Devices answering the same value overlap cleanly on the bus
+    if (_answer == -1) {
+        _answer = value;
+    } else if (_answer != value) {
+        _answer = BUS_MODEL_COLLISION;
+    }
+}
+
+void DALISimBus::forward(uint32_t data, int bits)
+{
+    _answer = -1;
+    // ENABLE DEVICE TYPE only applies to the next command
+    int device_type = _device_type;
+    _device_type = -1;
+
+    if (bits == 24) {
+        uint8_t addr = data >> 16;
+        uint8_t instance = (data >> 8) & 0xFF;
+        uint8_t opcode = data & 0xFF;
+        if (addr == 0xC1) {
+            input_special(instance, opcode);
+            return;
+        }
+        for (int i = 0; i < num_inputs; i++) {
+            if (input_addressed(inputs[i], addr)) {
+                input_command(inputs[i], instance, opcode);
+            }
+        }
+        return;
+    }
+
+    uint8_t addr = data >> 8;
+    uint8_t opcode = data & 0xFF;
+    if (addr >= 0xA0 && addr < 0xFC) {
+        if (addr == ENABLE_DEVICE_TYPE) {
+            _device_type = opcode;
+        } else {
+            gear_special(addr, opcode);
+        }
+        return;
+    }
+    for (int i = 0; i < num_gear; i++) {
+        sim_gear &g = gear[i];
+        if (!gear_addressed(g, addr)) {
+            continue;
+        }
+        if (addr & 0x01) {
+            if (opcode < 0xE0 || device_type == 8) {
+                gear_command(g, opcode);
+            }
+        } else if (opcode != SIM_MASK) {
+            // Direct arc power, limited to the configured range
+            uint8_t level = opcode;
+            if (level && level < g.min_level) {
+                level = g.min_level;
+            }
+            if (level > g.max_level) {
+                level = g.max_level;
+            }
+            g.level = level;
+        }
+    }
+}
+
+bool DALISimBus::gear_addressed(const sim_gear &g, uint8_t addr)
+{
+    if (addr >= 0xFE) {
+        return true;
+    }
+    if (addr >= 0xFC) {
+        return g.short_addr == SIM_MASK;
+    }
+    if (addr & 0x80) {
+        return g.groups & (1 << ((addr >> 1) & 0x0F));
+    }
+    return g.short_addr == (addr >> 1);
+}
+
+bool DALISimBus::gear_selected(const sim_gear &g, uint8_t data)
+{
+    if (data == 0x00) {
+        return true;
+    }
+    if (data == 0xFF) {
+        return g.short_addr == SIM_MASK;
+    }
+    return (data & 0x81) == 0x01 && g.short_addr == (data >> 1);
+}
+
+void DALISimBus::gear_special(uint8_t addr, uint8_t data)
+{
+    bool yes = false;
+    switch (addr) {
+        case INITIALISE:
+            for (int i = 0; i < num_gear; i++) {
+                // Withdrawn gear stays withdrawn until TERMINATE
+                if (gear_selected(gear[i], data) &&
+                    gear[i].init_state == SIM_DISABLED) {
+                    gear[i].init_state = SIM_ENABLED;
+                }
+            }
+            break;
+        case RANDOMISE:
+            _random_base = next_random(0) & 0xFFF000;
+            for (int i = 0; i < num_gear; i++) {
+                if (gear[i].init_state == SIM_DISABLED) {
+                    continue;
+                }
+                if (_mode == SIM_RANDOM_DUPLICATES && (i & 1) &&
+                    gear[i - 1].init_state != SIM_DISABLED) {
+                    gear[i].random_addr = gear[i - 1].random_addr;
+                } else {
+                    gear[i].random_addr = next_random(i);
+                }
+            }
+            break;
+        case COMPARE:
+            for (int i = 0; i < num_gear; i++) {
+                if (gear[i].init_state == SIM_ENABLED &&
+                    gear[i].random_addr <= _search_addr) {
+                    yes = true;
+                }
+            }
+            if (yes) {
+                answer(SIM_YES);
+            }
+            break;
+        case WITHDRAW:
+            for (int i = 0; i < num_gear; i++) {
+                if (gear[i].init_state == SIM_ENABLED &&
+                    gear[i].random_addr == _search_addr) {
+                    gear[i].init_state = SIM_WITHDRAWN;
+                }
+            }
+            break;
+        case SEARCHADDRH:
+            _search_addr = (_search_addr & 0x00FFFF) | ((uint32_t)data << 16);
+            break;
+        case SEARCHADDRM:
+            _search_addr = (_search_addr & 0xFF00FF) | ((uint32_t)data << 8);
+            break;
+        case SEARCHADDRL:
+            _search_addr = (_search_addr & 0xFFFF00) | data;
+            break;
+        case PROGRAM_SHORT_ADDR:
+            for (int i = 0; i < num_gear; i++) {
+                sim_gear &g = gear[i];
+                if (g.init_state != SIM_DISABLED &&
+                    g.random_addr == _search_addr) {
+                    if (data == SIM_MASK) {
+                        g.short_addr = SIM_MASK;
+                    } else if ((data & 0x81) == 0x01) {
+                        g.short_addr = data >> 1;
+                    }
+                }
+            }
+            break;
+        case QUERY_SHORT_ADDR:
+            for (int i = 0; i < num_gear; i++) {
+                sim_gear &g = gear[i];
+                if (g.init_state != SIM_DISABLED &&
+                    g.random_addr == _search_addr) {
+                    answer(g.short_addr == SIM_MASK ? SIM_MASK
+                                                    : (g.short_addr << 1) | 1);
+                }
+            }
+            break;
+        case TERMINATE:
+            for (int i = 0; i < num_gear; i++) {
+                gear[i].init_state = SIM_DISABLED;
+            }
+            break;
+        case DTR0:
+        case DTR1:
+        case DTR2:
+            for (int i = 0; i < num_gear; i++) {
+                int n = addr == DTR0 ? 0 : (addr == DTR1 ? 1 : 2);
+                gear[i].dtr[n] = data;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void DALISimBus::gear_command(sim_gear &g, uint8_t opcode)
+{
+    uint8_t n = opcode & 0x0F;
+    switch (opcode & 0xF0) {
+        case GO_TO_SCENE:
+            if (g.scenes[n] != SIM_MASK) {
+                g.level = g.scenes[n];
+            }
+            return;
+        case SET_SCENE:
+            g.scenes[n] = g.dtr[0];
+            return;
+        case REMOVE_FROM_SCENE:
+            g.scenes[n] = SIM_MASK;
+            return;
+        case ADD_TO_GROUP:
+            g.groups |= 1 << n;
+            return;
+        case REMOVE_FROM_GROUP:
+            g.groups &= ~(1 << n);
+            return;
+        case QUERY_SCENE_LEVEL:
+            answer(g.scenes[n]);
+            return;
+        default:
+            break;
+    }
+    switch (opcode) {
+        case OFF:
+            g.level = 0;
+            break;
+        case ON_AND_STEP_UP:
+            if (g.level == 0) {
+                g.level = g.min_level;
+            } else if (g.level < g.max_level) {
+                g.level++;
+            }
+            break;
+        case QUERY_ACTUAL_LEVEL:
+            answer(g.level);
+            break;
+        case QUERY_ERROR:
+            // Status: failures, lamp on, missing short address
+            answer(g.failures | (g.level ? 0x04 : 0) |
+                   (g.short_addr == SIM_MASK ? 0x40 : 0));
+            break;
+        case QUERY_CONTROL_GEAR_PRESENT:
+            answer(SIM_YES);
+            break;
+        case READ_MEM_LOC:
+            // Only memory bank 0 is modelled
+            if (g.dtr[1] == 0 && g.dtr[0] < sizeof(g.bank0)) {
+                answer(g.bank0[g.dtr[0]]);
+                g.dtr[0]++;
+            }
+            break;
+        case QUERY_LAMP_FAILURE:
+            if (g.failures & 0x02) {
+                answer(SIM_YES);
+            }
+            break;
+        case QUERY_LAMP_POWER_ON:
+            if (g.level) {
+                answer(SIM_YES);
+            }
+            break;
+        case QUERY_GEAR_GROUPS_L:
+            answer(g.groups & 0xFF);
+            break;
+        case QUERY_GEAR_GROUPS_H:
+            answer(g.groups >> 8);
+            break;
+        case QUERY_PHM:
+            answer(g.phm);
+            break;
+        case QUERY_FADE:
+            answer(g.fade);
+            break;
+        case QUERY_MAX_LEVEL:
+            answer(g.max_level);
+            break;
+        case QUERY_MIN_LEVEL:
+            answer(g.min_level);
+            break;
+        case QUERY_POWER_ON_LEVEL:
+            answer(g.power_on_level);
+            break;
+        case QUERY_SYSTEM_FAILURE_LEVEL:
+            answer(g.failure_level);
+            break;
+        case QUERY_COLOR_TYPE_FEATURES:
+            if (g.color_features) {
+                answer(g.color_features);
+            }
+            break;
+        case STORE_ACTUAL_LEVEL_IN_DTR0:
+            g.dtr[0] = g.level;
+            break;
+        case SET_FADE_TIME:
+            g.fade = (g.fade & 0x0F) | ((g.dtr[0] > 15 ? 15 : g.dtr[0]) << 4);
+            break;
+        case SET_FADE_RATE:
+            if (g.dtr[0] >= 1) {
+                g.fade = (g.fade & 0xF0) | (g.dtr[0] > 15 ? 15 : g.dtr[0]);
+            }
+            break;
+        case SET_MIN_LEVEL:
+            g.min_level = g.dtr[0] < g.phm ? g.phm : g.dtr[0];
+            if (g.min_level > g.max_level) {
+                g.min_level = g.max_level;
+            }
+            break;
+        case SET_MAX_LEVEL:
+            g.max_level = g.dtr[0] < g.min_level ? g.min_level : g.dtr[0];
+            if (g.max_level > 254) {
+                g.max_level = 254;
+            }
+            break;
+        case SET_POWER_ON_LEVEL:
+            g.power_on_level = g.dtr[0];
+            break;
+        case SET_SYSTEM_FAILURE_LEVEL:
+            g.failure_level = g.dtr[0];
+            break;
+        case SET_SHORT_ADDR:
+            if (g.dtr[0] == SIM_MASK) {
+                g.short_addr = SIM_MASK;
+            } else if ((g.dtr[0] & 0x81) == 0x01) {
+                g.short_addr = g.dtr[0] >> 1;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool DALISimBus::input_addressed(const sim_input &d, uint8_t addr)
+{
+    if (addr == 0xFF) {
+        return true;
+    }
+    if (addr == 0xFD) {
+        return d.short_addr == SIM_MASK;
+    }
+    if (addr & 0x80) {
+        // Device groups are not modelled
+        return false;
+    }
+    return d.short_addr == (addr >> 1);
+}
+
+bool DALISimBus::input_selected(const sim_input &d, uint8_t data)
+{
+    if (data == 0xFF) {
+        return true;
+    }
+    if (data == 0x7F) {
+        return d.short_addr == SIM_MASK;
+    }
+    return d.short_addr == data;
+}
+
+void DALISimBus::input_special(uint8_t instance, uint8_t data)
+{
+    bool yes = false;
+    switch (instance) {
+        case 0x00:
+            // TERMINATE
+            for (int i = 0; i < num_inputs; i++) {
+                inputs[i].init_state = SIM_DISABLED;
+            }
+            break;
+        case 0x01:
+            // INITIALISE
+            for (int i = 0; i < num_inputs; i++) {
+                if (input_selected(inputs[i], data) &&
+                    inputs[i].init_state == SIM_DISABLED) {
+                    inputs[i].init_state = SIM_ENABLED;
+                }
+            }
+            break;
+        case 0x02:
+            // RANDOMISE
+            _random_base = next_random(0) & 0xFFF000;
+            for (int i = 0; i < num_inputs; i++) {
+                if (inputs[i].init_state == SIM_DISABLED) {
+                    continue;
+                }
+                if (_mode == SIM_RANDOM_DUPLICATES && (i & 1) &&
+                    inputs[i - 1].init_state != SIM_DISABLED) {
+                    inputs[i].random_addr = inputs[i - 1].random_addr;
+                } else {
+                    inputs[i].random_addr = next_random(i);
+                }
+            }
+            break;
+        case 0x03:
+            // COMPARE
+            for (int i = 0; i < num_inputs; i++) {
+                if (inputs[i].init_state == SIM_ENABLED &&
+                    inputs[i].random_addr <= _input_search_addr) {
+                    yes = true;
+                }
+            }
+            if (yes) {
+                answer(SIM_YES);
+            }
+            break;
+        case 0x04:
+            // WITHDRAW
+            for (int i = 0; i < num_inputs; i++) {
+                if (inputs[i].init_state == SIM_ENABLED &&
+                    inputs[i].random_addr == _input_search_addr) {
+                    inputs[i].init_state = SIM_WITHDRAWN;
+                }
+            }
+            break;
+        case 0x05:
+            _input_search_addr =
+                (_input_search_addr & 0x00FFFF) | ((uint32_t)data << 16);
+            break;
+        case 0x06:
+            _input_search_addr =
+                (_input_search_addr & 0xFF00FF) | ((uint32_t)data << 8);
+            break;
+        case 0x07:
+            _input_search_addr = (_input_search_addr & 0xFFFF00) | data;
+            break;
+        case 0x08:
+            // PROGRAM SHORT ADDRESS
+            for (int i = 0; i < num_inputs; i++) {
+                sim_input &d = inputs[i];
+                if (d.init_state != SIM_DISABLED &&
+                    d.random_addr == _input_search_addr &&
+                    (data < 64 || data == SIM_MASK)) {
+                    d.short_addr = data;
+                }
+            }
+            break;
+        case 0x30:
+            // DTR0
+            for (int i = 0; i < num_inputs; i++) {
+                inputs[i].dtr0 = data;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void DALISimBus::input_command(sim_input &d, uint8_t instance,
+                               uint8_t opcode)
+{
+    if (instance == 0xFE) {
+        switch (opcode) {
+            case 0x14:
+                // SET SHORT ADDRESS
+                if (d.dtr0 < 64 || d.dtr0 == SIM_MASK) {
+                    d.short_addr = d.dtr0;
+                }
+                break;
+            case 0x1D:
+                d.quiescent = true;
+                break;
+            case 0x1E:
+                d.quiescent = false;
+                break;
+            case 0x35:
+                answer(d.num_instances);
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+    for (int j = 0; j < d.num_instances; j++) {
+        if (instance != 0xFF && instance != j) {
+            continue;
+        }
+        switch (opcode) {
+            case 0x62:
+                d.instance_enabled |= 1 << j;
+                break;
+            case 0x63:
+                d.instance_enabled &= ~(1 << j);
+                break;
+            case 0x80:
+                answer(d.instance_type[j]);
+                break;
+            case 0x86:
+                if (d.instance_enabled & (1 << j)) {
+                    answer(SIM_YES);
+                }
+                break;
+            case 0x8C:
+            case 0x8D:
+                answer(0);
+                break;
+            default:
+                break;
+        }
+    }
+}
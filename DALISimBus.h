@@ -0,0 +1,148 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DALI_SIM_BUS_H
+#define DALI_SIM_BUS_H
+
+#include "DALICommands.h"
+#include "manchester/bus_model.h"
+
+#define SIM_MAX_GEAR 64
+#define SIM_MAX_INPUTS 64
+#define SIM_MAX_INSTANCES 8
+
+// How the simulated devices pick their random address on RANDOMISE
+enum SimRandomMode {
+    // Uniform over the 24 bit range
+    SIM_RANDOM_UNIFORM,
+    // All devices within a 4096 wide window
+    SIM_RANDOM_CLUSTERED,
+    // Consecutive addresses
+    SIM_RANDOM_ADJACENT,
+    // Devices come in pairs sharing the same address
+    SIM_RANDOM_DUPLICATES
+};
+
+enum SimInitState { SIM_DISABLED, SIM_ENABLED, SIM_WITHDRAWN };
+
+// A simulated iec62386-102 control gear
+struct sim_gear {
+    // Short address, 0xFF when unaddressed
+    uint8_t short_addr;
+    uint32_t random_addr;
+    uint8_t init_state;
+    uint8_t dtr[3];
+    uint8_t level;
+    uint16_t groups;
+    uint8_t scenes[16];
+    // Fade time in the high nibble, fade rate in the low nibble
+    uint8_t fade;
+    uint8_t min_level;
+    uint8_t max_level;
+    uint8_t power_on_level;
+    uint8_t failure_level;
+    uint8_t phm;
+    // QUERY STATUS bits 0 (gear failure) and 1 (lamp failure)
+    uint8_t failures;
+    // Answer to QUERY COLOUR TYPE FEATURES, 0 for lights without DT8
+    uint8_t color_features;
+    // Memory bank 0 up to the identification number: GTIN at 0x03-0x08,
+    // identification number at 0x0B-0x12
+    uint8_t bank0[0x13];
+};
+
+// A simulated iec62386-103 input device
+struct sim_input {
+    uint8_t short_addr;
+    uint32_t random_addr;
+    uint8_t init_state;
+    uint8_t dtr0;
+    uint8_t num_instances;
+    uint8_t instance_type[SIM_MAX_INSTANCES];
+    uint8_t instance_enabled;
+    bool quiescent;
+};
+
+// Bus model simulating a DALI bus with control gear and input devices, used
+// to benchmark commissioning and other multi-device algorithms without
+// hardware. Only the commands the driver sends are modelled.
+class DALISimBus : public BusModel {
+public:
+    DALISimBus();
+
+    /** Power up a new set of devices, all without short address
+     *
+     *   @param num_gear     Number of control gear [0, SIM_MAX_GEAR]
+     *   @param num_inputs   Number of input devices [0, SIM_MAX_INPUTS]
+     *   @param instances    Instances per input device [0, SIM_MAX_INSTANCES]
+     *   @param mode         Random address distribution
+     *   @param seed         Seed for the random addresses
+     */
+    void reset(int num_gear, int num_inputs, int instances,
+               SimRandomMode mode, uint32_t seed = 1);
+
+    /** Connect one more control gear, without short address
+     *
+     *   @returns    index in gear, -1 when the bus is full
+     */
+    int plug_gear();
+
+    /** Connect one more input device, without short address
+     *
+     *   @param instances    Instances of the device [0, SIM_MAX_INSTANCES]
+     *   @returns            index in inputs, -1 when the bus is full
+     */
+    int plug_input(int instances);
+
+    virtual void forward(uint32_t data, int bits);
+
+    virtual int backward();
+
+    sim_gear gear[SIM_MAX_GEAR];
+    int num_gear;
+    sim_input inputs[SIM_MAX_INPUTS];
+    int num_inputs;
+
+private:
+    uint32_t next_random(int index);
+    void init_gear(sim_gear &g);
+    void init_input(sim_input &d, int instances);
+    void answer(int value);
+    bool gear_addressed(const sim_gear &g, uint8_t addr);
+    bool gear_selected(const sim_gear &g, uint8_t data);
+    void gear_special(uint8_t addr, uint8_t data);
+    void gear_command(sim_gear &g, uint8_t opcode);
+    bool input_addressed(const sim_input &d, uint8_t addr);
+    bool input_selected(const sim_input &d, uint8_t data);
+    void input_special(uint8_t instance, uint8_t data);
+    void input_command(sim_input &d, uint8_t instance, uint8_t opcode);
+
+    SimRandomMode _mode;
+    uint32_t _seed;
+    // Identification number of the next gear, the same devices come back
+    // with the same numbers after reset
+    uint32_t _next_serial;
+    // Base of the clustered and adjacent distributions
+    uint32_t _random_base;
+    uint32_t _search_addr;
+    uint32_t _input_search_addr;
+    // Device type enabled for the next command, -1 for none
+    int _device_type;
+    // Pending answer, -1 for none
+    int _answer;
+};
+
+#endif
@@ -0,0 +1,48 @@
+/* Manchester Encoder Library
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MAN_BUS_MODEL_H
+#define MAN_BUS_MODEL_H
+
+#include <stdint.h>
+
+// Returned by BusModel::backward when several devices answer differently
+#define BUS_MODEL_COLLISION (-2)
+
+// Stands in for the physical bus, see ManchesterEncoder::set_bus_model
+// While a model is attached the encoder does not touch its pins and keeps a
+// simulated clock that advances by the bus time of every frame
+class BusModel {
+public:
+    virtual ~BusModel()
+    {
+    }
+
+    /** Handle a forward frame sent by the encoder
+     *
+     *   @param data     Frame data
+     *   @param bits     Frame width, 16 or 24
+     */
+    virtual void forward(uint32_t data, int bits) = 0;
+
+    /** Answer the last forward frame
+     *
+     *   @returns    8 bit backward frame, -1 when nothing answers or
+     * BUS_MODEL_COLLISION
+     */
+    virtual int backward() = 0;
+};
+
+#endif
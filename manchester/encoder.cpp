@@ -16,6 +16,18 @@
 
 #include "encoder.h"
 
+#ifdef DALI_ISR_PROFILE
+#if !defined(DWT)
+#error "DALI_ISR_PROFILE needs the DWT cycle counter (Cortex-M3 and up)"
+#endif
+#define ISR_PROFILE_BEGIN() uint32_t isr_start = DWT->CYCCNT
+#define ISR_PROFILE_END(handler)                                               \
+    profile_handler(handler, DWT->CYCCNT - isr_start)
+#else
+#define ISR_PROFILE_BEGIN()
+#define ISR_PROFILE_END(handler)
+#endif
+
 ManchesterEncoder::ManchesterEncoder(PinName out_pin, PinName in_pin, int baud,
                                      bool idle_state)
     : _output_pin(out_pin), _input_pin(in_pin, PullUp)
@@ -29,13 +41,65 @@ ManchesterEncoder::ManchesterEncoder(PinName out_pin, PinName in_pin, int baud,
     data_ready = false;
     recv_data = 0;
     bit_recv_total = 8;
+    rx_overrun = false;
+    _trace_buf = NULL;
+    _trace_size = 0;
+    _model = NULL;
+    _model_us = 0;
+    reset_stats();
+    _clock.start();
+#ifdef DALI_ISR_PROFILE
+    // Enable the cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    reset_isr_profile();
+#endif
 }
 
 // Blocking receive call
 int ManchesterEncoder::recv()
 {
-    // -1 means no data ready in timeout period
+    uint32_t start = now_us();
+    if (_model) {
+        recv_model();
+    } else {
+        recv_pins();
+    }
+    // Only a frame received since the last forward frame is an answer, see
+    // listen
     int ret = -1;
+    if (data_ready) {
+        ret = recv_data;
+        data_ready = false;
+    }
+    if (ret < 0) {
+        _stats.no_answer++;
+        if (_trace_buf) {
+            trace(start, trace_pack(0, 0, TRACE_BACKWARD, TRACE_NO_ANSWER));
+        }
+    }
+    _stats.recv_wait_us += now_us() - start;
+    return ret;
+}
+
+void ManchesterEncoder::recv_model()
+{
+    // Same timing as the bus: response gap, then the backward frame
+    _model_us += 2400;
+    int ret = _model->backward();
+    if (ret >= 0) {
+        received(ret, 8, TRACE_OK, _model_us);
+    } else if (ret == BUS_MODEL_COLLISION) {
+        // Overlapping answers decode as garbage, not as silence
+        received(0, 8, TRACE_COLLISION, _model_us);
+    } else {
+        return;
+    }
+    _model_us += frame_time_us(8);
+}
+
+void ManchesterEncoder::recv_pins()
+{
     // Wait for timeout between response
     wait_us(2400);
     // Calculate timer stop time, 9 recv bits, stop condition, half bit extra
@@ -47,18 +111,36 @@ int ManchesterEncoder::recv()
     while (rx_in_progress && t.read_us() < stop_time) {
     };
     t.stop();
-    if (data_ready) {
-        // If there is data, clear our buffer
-        ret = recv_data;
-        recv_data = 0;
+}
+
+void ManchesterEncoder::received(uint32_t data, uint8_t bits,
+                                 TraceStatus status, uint32_t start_us)
+{
+    recv_data = data;
+    data_ready = true;
+    _stats.frames_received++;
+    _stats.bytes_received += bits >> 3;
+    _stats.bus_busy_us += frame_time_us(bits);
+    if (status == TRACE_COLLISION) {
+        _stats.collisions++;
+    } else if (status == TRACE_FRAMING_ERROR) {
+        _stats.framing_errors++;
+    }
+    if (_trace_buf) {
+        trace(start_us, trace_pack(data, bits, TRACE_BACKWARD, status));
     }
-    return ret;
 }
 
 void ManchesterEncoder::send_24(uint32_t data_out)
 {
+    if (_model) {
+        send_model(data_out, 24);
+        return;
+    }
     // We don't want to be preempted because this is time sensitive
     core_util_critical_section_enter();
+    uint32_t start = now_us();
+    uint32_t frame = data_out;
     clear_interrupts();
     // Send start condition
     _output_pin = !_idle_state;
@@ -79,11 +161,35 @@ void ManchesterEncoder::send_24(uint32_t data_out)
     // Send the stop condition
     _output_pin = _idle_state;
     bit_recv_total = 8;
+    _stats.frames_24++;
+    _stats.bytes_sent += 3;
+    _stats.bus_busy_us += frame_time_us(24);
+    if (_trace_buf) {
+        trace(start, trace_pack(frame, 24, TRACE_FORWARD, TRACE_OK));
+    }
     core_util_critical_section_exit();
-    _input_pin.rise(callback(this, &ManchesterEncoder::rise_handler));
+    listen();
     wait_us(13500);
 }
 
+void ManchesterEncoder::send_model(uint32_t data_out, int bits)
+{
+    listen();
+    if (_trace_buf) {
+        trace(_model_us, trace_pack(data_out, bits, TRACE_FORWARD, TRACE_OK));
+    }
+    _model->forward(data_out, bits);
+    if (bits == 24) {
+        _stats.frames_24++;
+    } else {
+        _stats.frames_16++;
+    }
+    _stats.bytes_sent += bits >> 3;
+    _stats.bus_busy_us += frame_time_us(bits);
+    // Frame plus the settling time send() waits for
+    _model_us += frame_time_us(bits) + 13500;
+}
+
 void ManchesterEncoder::set_recv_frame_length(int num)
 {
     bit_recv_total = num;
@@ -91,8 +197,14 @@ void ManchesterEncoder::set_recv_frame_length(int num)
 
 void ManchesterEncoder::send(uint16_t data_out)
 {
+    if (_model) {
+        send_model(data_out, 16);
+        return;
+    }
     // We don't want to be preempted because this is time sensitive
     core_util_critical_section_enter();
+    uint32_t start = now_us();
+    uint32_t frame = data_out;
     clear_interrupts();
     // Send start condition
     _output_pin = !_idle_state;
@@ -113,8 +225,14 @@ void ManchesterEncoder::send(uint16_t data_out)
     // Send the stop condition
     _output_pin = _idle_state;
     bit_recv_total = 8;
+    _stats.frames_16++;
+    _stats.bytes_sent += 2;
+    _stats.bus_busy_us += frame_time_us(16);
+    if (_trace_buf) {
+        trace(start, trace_pack(frame, 16, TRACE_FORWARD, TRACE_OK));
+    }
     core_util_critical_section_exit();
-    _input_pin.rise(callback(this, &ManchesterEncoder::rise_handler));
+    listen();
     wait_us(13500);
 }
 
@@ -142,28 +260,224 @@ void ManchesterEncoder::reattach()
     attach(_sensor_event_cb_save);
 }
 
+void ManchesterEncoder::get_stats(encoder_stats &stats)
+{
+    // Some counters are updated from interrupt context
+    core_util_critical_section_enter();
+    stats = _stats;
+    core_util_critical_section_exit();
+}
+
+void ManchesterEncoder::reset_stats()
+{
+    core_util_critical_section_enter();
+    memset(&_stats, 0, sizeof(_stats));
+    core_util_critical_section_exit();
+}
+
+uint32_t ManchesterEncoder::get_frame_count()
+{
+    return _stats.frames_16 + _stats.frames_24;
+}
+
+uint32_t ManchesterEncoder::get_received_count()
+{
+    return _stats.frames_received;
+}
+
+uint32_t ManchesterEncoder::now_us()
+{
+    if (_model) {
+        return _model_us;
+    }
+    return (uint32_t)_clock.read_high_resolution_us();
+}
+
+uint32_t ManchesterEncoder::frame_time_us(int bits)
+{
+    // One start bit, the data bits and a two bit stop condition
+    return (2 * (bits + 1) + 4) * _half_bit_time;
+}
+
+void ManchesterEncoder::set_bus_model(BusModel *model)
+{
+    _model = model;
+    _model_us = 0;
+}
+
+void ManchesterEncoder::idle(uint32_t us)
+{
+    if (_model) {
+        _model_us += us;
+        return;
+    }
+    // Sleep for the milliseconds, spin for the rest
+    wait_ms(us / 1000);
+    wait_us(us % 1000);
+}
+
+void ManchesterEncoder::enable_trace(trace_record *buffer, uint16_t size)
+{
+    core_util_critical_section_enter();
+    _trace_head = 0;
+    _trace_count = 0;
+    _trace_dropped = 0;
+    _trace_size = size;
+    _trace_buf = size ? buffer : NULL;
+    core_util_critical_section_exit();
+}
+
+void ManchesterEncoder::disable_trace()
+{
+    core_util_critical_section_enter();
+    _trace_buf = NULL;
+    core_util_critical_section_exit();
+}
+
+void ManchesterEncoder::dump_trace(
+    mbed::Callback<void(const uint8_t *, size_t)> sink)
+{
+    // Stop recording so the ring buffer is stable while the sink runs
+    core_util_critical_section_enter();
+    trace_record *buf = _trace_buf;
+    _trace_buf = NULL;
+    core_util_critical_section_exit();
+    if (!buf) {
+        return;
+    }
+    uint8_t chunk[TRACE_HEADER_SIZE];
+    memcpy(chunk, TRACE_MAGIC, 4);
+    chunk[4] = TRACE_VERSION;
+    chunk[5] = 0;
+    chunk[6] = _half_bit_time & 0xFF;
+    chunk[7] = _half_bit_time >> 8;
+    trace_put_u32(&chunk[8], _trace_count);
+    trace_put_u32(&chunk[12], _trace_dropped);
+    sink(chunk, TRACE_HEADER_SIZE);
+    // Oldest record is the one the next write would overwrite
+    uint16_t idx = (_trace_head + _trace_size - _trace_count) % _trace_size;
+    for (int i = 0; i < _trace_count; i++) {
+        trace_put_u32(&chunk[0], buf[idx].timestamp_us);
+        trace_put_u32(&chunk[4], buf[idx].frame);
+        sink(chunk, TRACE_RECORD_SIZE);
+        idx = (idx + 1) % _trace_size;
+    }
+    core_util_critical_section_enter();
+    _trace_buf = buf;
+    core_util_critical_section_exit();
+}
+
+void ManchesterEncoder::trace(uint32_t timestamp, uint32_t frame)
+{
+    // Called from thread and interrupt context
+    core_util_critical_section_enter();
+    _trace_buf[_trace_head].timestamp_us = timestamp;
+    _trace_buf[_trace_head].frame = frame;
+    _trace_head = (_trace_head + 1) % _trace_size;
+    if (_trace_count < _trace_size) {
+        _trace_count++;
+    } else {
+        _trace_dropped++;
+    }
+    core_util_critical_section_exit();
+}
+
+#ifdef DALI_ISR_PROFILE
+void ManchesterEncoder::get_isr_profile(isr_profile &profile)
+{
+    core_util_critical_section_enter();
+    profile = _isr_profile;
+    core_util_critical_section_exit();
+    profile.core_clock_hz = SystemCoreClock;
+}
+
+void ManchesterEncoder::reset_isr_profile()
+{
+    core_util_critical_section_enter();
+    memset(&_isr_profile, 0, sizeof(_isr_profile));
+    _frame_cycles = 0;
+    core_util_critical_section_exit();
+}
+
+void ManchesterEncoder::profile_handler(IsrHandler handler, uint32_t cycles)
+{
+    isr_cost &cost = _isr_profile.handler[handler];
+    cost.calls++;
+    cost.total_cycles += cycles;
+    if (cycles > cost.max_cycles) {
+        cost.max_cycles = cycles;
+    }
+    _frame_cycles += cycles;
+}
+
+void ManchesterEncoder::profile_frame()
+{
+    isr_cost &cost = _isr_profile.frame;
+    cost.calls++;
+    cost.total_cycles += _frame_cycles;
+    if (_frame_cycles > cost.max_cycles) {
+        cost.max_cycles = _frame_cycles;
+    }
+    _frame_cycles = 0;
+}
+#endif
+
 void ManchesterEncoder::clear_interrupts()
 {
     _input_pin.rise(0);
     _input_pin.fall(0);
 }
 
+void ManchesterEncoder::listen()
+{
+    // An answer received before is not one to the frame just sent
+    data_ready = false;
+    if (_model) {
+        return;
+    }
+    _input_pin.rise(callback(this, &ManchesterEncoder::rise_handler));
+}
+
 void ManchesterEncoder::stop()
 {
+    ISR_PROFILE_BEGIN();
+#ifdef DALI_ISR_PROFILE
+    bool frame_done = rx_in_progress;
+#endif
     clear_interrupts();
     if (rx_in_progress) {
-        data_ready = true;
+        TraceStatus status = TRACE_OK;
+        if (rx_overrun) {
+            status = TRACE_COLLISION;
+        } else if (bit_count < bit_recv_total) {
+            status = TRACE_FRAMING_ERROR;
+        }
+        received(recv_data, bit_recv_total, status, rx_start_us);
     }
     rx_in_progress = false;
     // Call sensor event handler
+#ifdef DALI_ISR_PROFILE
+    uint32_t cb_start = DWT->CYCCNT;
+#endif
     if (_sensor_event_cb)
         _sensor_event_cb(recv_data);
+#ifdef DALI_ISR_PROFILE
+    // The application callback is not part of the decoder cost
+    isr_start += DWT->CYCCNT - cb_start;
+#endif
     event_flags.set(DONE_FLAG);
     _input_pin.rise(callback(this, &ManchesterEncoder::rise_handler));
+    ISR_PROFILE_END(ISR_STOP);
+#ifdef DALI_ISR_PROFILE
+    if (frame_done) {
+        profile_frame();
+    }
+#endif
 }
 
 void ManchesterEncoder::irq_handler()
 {
+    ISR_PROFILE_BEGIN();
     clear_interrupts();
     rx_in_progress = true;
     data_ready = false;
@@ -172,30 +486,49 @@ void ManchesterEncoder::irq_handler()
     t1.attach_us(callback(this, &ManchesterEncoder::read_state),
                  1.5 * (float)_half_bit_time);
     t2.attach_us(callback(this, &ManchesterEncoder::stop), 2450);
+    ISR_PROFILE_END(ISR_IRQ_HANDLER);
 }
 
 void ManchesterEncoder::read_state()
 {
+    ISR_PROFILE_BEGIN();
     int state = _input_pin.read();
     if (bit_count < bit_recv_total) {
         uint32_t mask = ((bool)state) << ((bit_recv_total - 1) - bit_count++);
         recv_data |= mask;
+    } else if (state || bit_count > bit_recv_total) {
+        // More bits than expected, another sender is on the bus
+        rx_overrun = true;
+    } else {
+        // The sample after the last bit reads the idle stop condition, any
+        // edge after it starts an extra bit
+        bit_count++;
     }
     if (state == 0) {
         _input_pin.rise(callback(this, &ManchesterEncoder::irq_handler));
     } else {
         _input_pin.fall(callback(this, &ManchesterEncoder::irq_handler));
     }
+    ISR_PROFILE_END(ISR_READ_STATE);
 }
 
 void ManchesterEncoder::rise_handler()
 {
+    ISR_PROFILE_BEGIN();
+#ifdef DALI_ISR_PROFILE
+    _frame_cycles = 0;
+#endif
     bit_count = 0;
     recv_data = 0;
+    rx_overrun = false;
+    if (_trace_buf) {
+        rx_start_us = now_us();
+    }
     clear_interrupts();
     // fall handler called in less than 1.5*_half_bit_time means start condition
     _input_pin.fall(callback(this, &ManchesterEncoder::irq_handler));
     // Stop condition if rise handler is not called in time
     t2.attach_us(callback(this, &ManchesterEncoder::stop),
                  1.5 * (float)_half_bit_time);
+    ISR_PROFILE_END(ISR_RISE_HANDLER);
 }
@@ -16,7 +16,9 @@
 #ifndef MAN_ENCODING_H
 #define MAN_ENCODING_H
 
+#include "bus_model.h"
 #include "mbed.h"
+#include "trace.h"
 
 #define DONE_FLAG (1UL << 0)
 
@@ -26,6 +28,52 @@ struct event_msg {
     uint16_t info;
 };
 
+// Bus traffic counters kept by the encoder, see ManchesterEncoder::get_stats
+struct encoder_stats {
+    // Forward frames sent, by width
+    uint32_t frames_16;
+    uint32_t frames_24;
+    // Frames received (backward frames and input device events)
+    uint32_t frames_received;
+    uint32_t bytes_sent;
+    uint32_t bytes_received;
+    // recv() calls that timed out without any data
+    uint32_t no_answer;
+    // Received frames that stopped before the expected number of bits
+    uint32_t framing_errors;
+    // Received frames with more bits than expected (overlapping senders)
+    uint32_t collisions;
+    // Time the bus carried a frame sent or received by us
+    uint32_t bus_busy_us;
+    // Time spent blocked in recv()
+    uint32_t recv_wait_us;
+};
+
+#ifdef DALI_ISR_PROFILE
+// Receive interrupt handlers, see ManchesterEncoder::get_isr_profile
+enum IsrHandler {
+    ISR_IRQ_HANDLER,
+    ISR_READ_STATE,
+    ISR_RISE_HANDLER,
+    ISR_STOP,
+    ISR_COUNT
+};
+
+struct isr_cost {
+    uint32_t calls;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+};
+
+// Cycle cost of the receive path, cycles / (core_clock_hz / 1e9) gives ns
+struct isr_profile {
+    isr_cost handler[ISR_COUNT];
+    // All handler cycles of a received frame, calls counts frames
+    isr_cost frame;
+    uint32_t core_clock_hz;
+};
+#endif
+
 class ManchesterEncoder {
 public:
     // Flag data ready
@@ -49,9 +97,102 @@ public:
 
     void reattach();
 
+    /** Copy the traffic counters
+     *
+     *   @param stats    Filled with the counters since the last reset
+     */
+    void get_stats(encoder_stats &stats);
+
+    /** Zero the traffic counters
+     */
+    void reset_stats();
+
+    /** Get the number of forward frames sent since the last stats reset
+     */
+    uint32_t get_frame_count();
+
+    /** Get the number of frames received since the last stats reset
+     */
+    uint32_t get_received_count();
+
+    /** Get the time on the encoder clock
+     *
+     *   @returns    microseconds, wraps around every ~71 minutes
+     */
+    uint32_t now_us();
+
+    /** Get the time a frame occupies the bus
+     *
+     *   @param bits     Number of data bits in the frame
+     *   @returns        Start bit, data bits and stop condition in microseconds
+     */
+    uint32_t frame_time_us(int bits);
+
+    /** Record every frame sent and received in a ring buffer
+     *
+     *   @param buffer   Storage for the records, owned by the caller
+     *   @param size     Number of records in buffer, the oldest records are
+     * overwritten when it is full
+     */
+    void enable_trace(trace_record *buffer, uint16_t size);
+
+    /** Stop recording frames
+     */
+    void disable_trace();
+
+    /** Write the recorded frames, oldest first, in the format of trace.h
+     *
+     *   @param sink     Called with consecutive chunks of the dump
+     *   NOTE: frames on the bus while dumping are not recorded
+     */
+    void dump_trace(mbed::Callback<void(const uint8_t *, size_t)> sink);
+
+    /** Replace the physical bus with a model
+     *
+     *   @param model    Model answering the frames, NULL to use the pins again
+     *   NOTE: the encoder clock (now_us) is simulated while a model is set
+     */
+    void set_bus_model(BusModel *model);
+
+    /** Keep the bus idle
+     *
+     *   @param us   Time to wait in microseconds, simulated with a bus model
+     */
+    void idle(uint32_t us);
+
+#ifdef DALI_ISR_PROFILE
+    /** Copy the cycle cost of the receive interrupt handlers
+     *
+     *   @param profile  Filled with the cost since the last reset
+     *   NOTE: only built with DALI_ISR_PROFILE defined, needs the DWT cycle
+     * counter
+     */
+    void get_isr_profile(isr_profile &profile);
+
+    /** Zero the interrupt handler cycle counts
+     */
+    void reset_isr_profile();
+#endif
+
 private:
+    // Send a frame to the bus model instead of the pins
+    void send_model(uint32_t data_out, int bits);
+
+    // Wait for a backward frame from the model or the pins
+    void recv_model();
+    void recv_pins();
+
+    // Hand a received frame to recv and count it
+    void received(uint32_t data, uint8_t bits, TraceStatus status,
+                  uint32_t start_us);
+
+    void trace(uint32_t timestamp, uint32_t frame);
+
     void clear_interrupts();
 
+    // Start receiving after a forward frame and drop any earlier answer
+    void listen();
+
     void stop();
 
     void irq_handler();
@@ -72,12 +213,37 @@ private:
     // Total amount of bits expected
     volatile uint8_t bit_recv_total;
     bool _idle_state;
+    // Set when more bits arrive than bit_recv_total
+    volatile bool rx_overrun;
+    // Free running clock for the statistics
+    Timer _clock;
+    // Bus model and its simulated clock, see set_bus_model
+    BusModel *_model;
+    uint32_t _model_us;
+    encoder_stats _stats;
+    // Frame trace ring buffer, NULL when tracing is off
+    trace_record *_trace_buf;
+    uint16_t _trace_size;
+    uint16_t _trace_head;
+    uint16_t _trace_count;
+    uint32_t _trace_dropped;
+    // Start of the frame being received, only kept while tracing
+    volatile uint32_t rx_start_us;
     Timeout t1;
     Timeout t2;
     EventFlags event_flags;
 
     Callback<void(uint32_t)> _sensor_event_cb;
     Callback<void(uint32_t)> _sensor_event_cb_save;
+
+#ifdef DALI_ISR_PROFILE
+    void profile_handler(IsrHandler handler, uint32_t cycles);
+    void profile_frame();
+
+    isr_profile _isr_profile;
+    // Handler cycles of the frame being received
+    uint32_t _frame_cycles;
+#endif
 };
 
 #endif
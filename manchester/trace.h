@@ -0,0 +1,104 @@
+/* Manchester Encoder Library
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MAN_TRACE_H
+#define MAN_TRACE_H
+
+// Frame trace format, shared with the host side decoder so it must not depend
+// on mbed
+//
+// A dump is a 16 byte header followed by the records, oldest first, all
+// fields little endian:
+//   0   "DALT" magic
+//   4   format version (uint8)
+//   5   reserved (uint8)
+//   6   half bit time in microseconds (uint16)
+//   8   number of records in the dump (uint32)
+//   12  records overwritten before the dump (uint32)
+//   16  records, 8 bytes each: timestamp_us (uint32), frame (uint32)
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC "DALT"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_RECORD_SIZE 8
+
+// Frames we sent are forward, everything we receive is backward (this
+// includes 24 bit event messages from input devices)
+enum TraceDirection { TRACE_FORWARD = 0, TRACE_BACKWARD = 1 };
+
+enum TraceStatus {
+    TRACE_OK = 0,
+    // recv() timed out, data and width are zero
+    TRACE_NO_ANSWER = 1,
+    // Frame stopped before the expected number of bits
+    TRACE_FRAMING_ERROR = 2,
+    // More bits than expected, another sender was on the bus
+    TRACE_COLLISION = 3
+};
+
+// One traced frame
+struct trace_record {
+    // Encoder clock at the start of the frame
+    uint32_t timestamp_us;
+    // Bits 0-23 frame data, bits 24-28 width in bits, bit 29 direction,
+    // bits 30-31 status
+    uint32_t frame;
+};
+
+inline uint32_t trace_pack(uint32_t data, int width, TraceDirection dir,
+                           TraceStatus status)
+{
+    return (data & 0xFFFFFF) | ((uint32_t)(width & 0x1F) << 24) |
+           ((uint32_t)dir << 29) | ((uint32_t)status << 30);
+}
+
+inline uint32_t trace_data(const trace_record &r)
+{
+    return r.frame & 0xFFFFFF;
+}
+
+inline int trace_width(const trace_record &r)
+{
+    return (r.frame >> 24) & 0x1F;
+}
+
+inline TraceDirection trace_direction(const trace_record &r)
+{
+    return (TraceDirection)((r.frame >> 29) & 0x01);
+}
+
+inline TraceStatus trace_status(const trace_record &r)
+{
+    return (TraceStatus)(r.frame >> 30);
+}
+
+inline void trace_put_u32(uint8_t *buf, uint32_t val)
+{
+    buf[0] = val & 0xFF;
+    buf[1] = (val >> 8) & 0xFF;
+    buf[2] = (val >> 16) & 0xFF;
+    buf[3] = val >> 24;
+}
+
+inline uint32_t trace_get_u32(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+           ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+#endif
@@ -0,0 +1,402 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host tool printing a frame trace dump (see manchester/trace.h) as DALI
+// commands with the gaps between frames
+//
+// Build: c++ -I.. -o dali_trace_decode dali_trace_decode.cpp
+// Usage: dali_trace_decode [dump file]    (reads stdin without a file)
+
+#include "../DALICommands.h"
+#include "../manchester/trace.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *special_name(uint8_t addr)
+{
+    switch (addr) {
+        case SEARCHADDRH:
+            return "SEARCHADDRH";
+        case SEARCHADDRM:
+            return "SEARCHADDRM";
+        case SEARCHADDRL:
+            return "SEARCHADDRL";
+        case DTR0:
+            return "DTR0";
+        case DTR1:
+            return "DTR1";
+        case DTR2:
+            return "DTR2";
+        case INITIALISE:
+            return "INITIALISE";
+        case RANDOMISE:
+            return "RANDOMISE";
+        case PROGRAM_SHORT_ADDR:
+            return "PROGRAM_SHORT_ADDR";
+        case QUERY_SHORT_ADDR:
+            return "QUERY_SHORT_ADDR";
+        case COMPARE:
+            return "COMPARE";
+        case TERMINATE:
+            return "TERMINATE";
+        case ENABLE_DEVICE_TYPE:
+            return "ENABLE_DEVICE_TYPE";
+        case WITHDRAW:
+            return "WITHDRAW";
+        default:
+            return NULL;
+    }
+}
+
+// Commands that take a scene or group number in the low nibble
+static const char *ranged_name(uint8_t opcode)
+{
+    switch (opcode & 0xF0) {
+        case GO_TO_SCENE:
+            return "GO_TO_SCENE";
+        case SET_SCENE:
+            return "SET_SCENE";
+        case REMOVE_FROM_SCENE:
+            return "REMOVE_FROM_SCENE";
+        case ADD_TO_GROUP:
+            return "ADD_TO_GROUP";
+        case REMOVE_FROM_GROUP:
+            return "REMOVE_FROM_GROUP";
+        case QUERY_SCENE_LEVEL:
+            return "QUERY_SCENE_LEVEL";
+        default:
+            return NULL;
+    }
+}
+
+static const char *command_name(uint8_t opcode, int device_type)
+{
+    // Application extended commands depend on the enabled device type
+    if (opcode >= 0xE0 && device_type != 8) {
+        return NULL;
+    }
+    switch (opcode) {
+        case OFF:
+            return "OFF";
+        case ON_AND_STEP_UP:
+            return "ON_AND_STEP_UP";
+        case QUERY_GEAR_GROUPS_L:
+            return "QUERY_GEAR_GROUPS_L";
+        case QUERY_GEAR_GROUPS_H:
+            return "QUERY_GEAR_GROUPS_H";
+        case QUERY_ACTUAL_LEVEL:
+            return "QUERY_ACTUAL_LEVEL";
+        case QUERY_ERROR:
+            return "QUERY_ERROR";
+        case QUERY_CONTROL_GEAR_PRESENT:
+            return "QUERY_CONTROL_GEAR_PRESENT";
+        case QUERY_LAMP_FAILURE:
+            return "QUERY_LAMP_FAILURE";
+        case QUERY_LAMP_POWER_ON:
+            return "QUERY_LAMP_POWER_ON";
+        case QUERY_PHM:
+            return "QUERY_PHM";
+        case QUERY_FADE:
+            return "QUERY_FADE";
+        case QUERY_MAX_LEVEL:
+            return "QUERY_MAX_LEVEL";
+        case QUERY_MIN_LEVEL:
+            return "QUERY_MIN_LEVEL";
+        case QUERY_POWER_ON_LEVEL:
+            return "QUERY_POWER_ON_LEVEL";
+        case QUERY_SYSTEM_FAILURE_LEVEL:
+            return "QUERY_SYSTEM_FAILURE_LEVEL";
+        case QUERY_COLOR_TYPE_FEATURES:
+            return "QUERY_COLOR_TYPE_FEATURES";
+        case READ_MEM_LOC:
+            return "READ_MEM_LOC";
+        case SET_TEMP_RGB_DIM:
+            return "SET_TEMP_RGB_DIM";
+        case SET_TEMP_TEMPC:
+            return "SET_TEMP_TEMPC";
+        case SET_TEMP_WAF_DIM:
+            return "SET_TEMP_WAF_DIM";
+        case COLOR_ACTIVATE:
+            return "COLOR_ACTIVATE";
+        case SET_TEMP_X_COORD:
+            return "SET_TEMP_X_COORD";
+        case SET_TEMP_Y_COORD:
+            return "SET_TEMP_Y_COORD";
+        case QUERY_COLOR_VALUE:
+            return "QUERY_COLOR_VALUE";
+        case QUERY_CONTENT_DTR0:
+            return "QUERY_CONTENT_DTR0";
+        case COPY_REPORT_TO_TEMP:
+            return "COPY_REPORT_TO_TEMP";
+        case STORE_ACTUAL_LEVEL_IN_DTR0:
+            return "STORE_ACTUAL_LEVEL_IN_DTR0";
+        case SET_FADE_TIME:
+            return "SET_FADE_TIME";
+        case SET_FADE_RATE:
+            return "SET_FADE_RATE";
+        case SET_MIN_LEVEL:
+            return "SET_MIN_LEVEL";
+        case SET_MAX_LEVEL:
+            return "SET_MAX_LEVEL";
+        case SET_SYSTEM_FAILURE_LEVEL:
+            return "SET_SYSTEM_FAILURE_LEVEL";
+        case SET_POWER_ON_LEVEL:
+            return "SET_POWER_ON_LEVEL";
+        case SET_SHORT_ADDR:
+            return "SET_SHORT_ADDR";
+        default:
+            return NULL;
+    }
+}
+
+// iec62386-103 commands the driver sends, by opcode
+static const char *input_command_name(uint8_t opcode)
+{
+    switch (opcode) {
+        case 0x14:
+            return "SET_SHORT_ADDR";
+        case 0x18:
+            return "SET_OPERATING_MODE";
+        case 0x1D:
+            return "START_QUIESCENT_MODE";
+        case 0x1E:
+            return "STOP_QUIESCENT_MODE";
+        case 0x35:
+            return "QUERY_NUMBER_OF_INSTANCES";
+        case 0x62:
+            return "ENABLE_INSTANCE";
+        case 0x63:
+            return "DISABLE_INSTANCE";
+        case 0x67:
+            return "SET_EVENT_SCHEME";
+        case 0x68:
+            return "SET_EVENT_FILTER";
+        case 0x80:
+            return "QUERY_INSTANCE_TYPE";
+        case 0x86:
+            return "QUERY_INSTANCE_ENABLED";
+        case 0x8C:
+            return "QUERY_INPUT_VALUE";
+        case 0x8D:
+            return "QUERY_INPUT_VALUE_LATCH";
+        default:
+            return NULL;
+    }
+}
+
+// iec62386-103 special commands, by the instance byte
+static const char *input_special_name(uint8_t instance)
+{
+    switch (instance) {
+        case 0x00:
+            return "TERMINATE";
+        case 0x01:
+            return "INITIALISE";
+        case 0x02:
+            return "RANDOMISE";
+        case 0x03:
+            return "COMPARE";
+        case 0x04:
+            return "WITHDRAW";
+        case 0x05:
+            return "SEARCHADDRH";
+        case 0x06:
+            return "SEARCHADDRM";
+        case 0x07:
+            return "SEARCHADDRL";
+        case 0x08:
+            return "PROGRAM_SHORT_ADDR";
+        case 0x30:
+            return "DTR0";
+        default:
+            return NULL;
+    }
+}
+
+// Print the address part of a standard or direct command
+static void print_addr(uint8_t addr)
+{
+    if (addr >= 0xFE) {
+        printf("BC ");
+    } else if (addr >= 0xFC) {
+        printf("BC-UNADDR ");
+    } else if (addr & 0x80) {
+        printf("G%d ", (addr >> 1) & 0x0F);
+    } else {
+        printf("A%d ", addr >> 1);
+    }
+}
+
+// Decode a 16 bit forward frame, returns the device type it enables
+static int print_forward_16(uint32_t data, int device_type)
+{
+    uint8_t addr = data >> 8;
+    uint8_t opcode = data & 0xFF;
+    const char *name = special_name(addr);
+    if (name && (addr & 0x01)) {
+        printf("%s 0x%02X", name, opcode);
+        return addr == ENABLE_DEVICE_TYPE ? opcode : -1;
+    }
+    if (addr >= 0xA0 && addr < 0xFC) {
+        printf("SPECIAL 0x%02X 0x%02X", addr, opcode);
+        return -1;
+    }
+    print_addr(addr);
+    if (!(addr & 0x01)) {
+        printf("DAPC %d", opcode);
+    } else if ((name = ranged_name(opcode)) != NULL) {
+        printf("%s %d", name, opcode & 0x0F);
+    } else if ((name = command_name(opcode, device_type)) != NULL) {
+        printf("%s", name);
+    } else {
+        printf("CMD 0x%02X", opcode);
+    }
+    return -1;
+}
+
+static void print_forward_24(uint32_t data)
+{
+    uint8_t addr = data >> 16;
+    uint8_t instance = (data >> 8) & 0xFF;
+    uint8_t opcode = data & 0xFF;
+    const char *name;
+    if (addr == 0xC1) {
+        name = input_special_name(instance);
+        if (name) {
+            printf("INPUT %s 0x%02X", name, opcode);
+        } else {
+            printf("INPUT SPECIAL 0x%02X 0x%02X", instance, opcode);
+        }
+        return;
+    }
+    printf("INPUT ");
+    print_addr(addr);
+    if (instance == 0xFE) {
+        printf("DEVICE ");
+    } else if (instance == 0xFF) {
+        printf("ALL-INST ");
+    } else {
+        printf("I%d ", instance);
+    }
+    name = input_command_name(opcode);
+    if (name) {
+        printf("%s", name);
+    } else {
+        printf("CMD 0x%02X", opcode);
+    }
+}
+
+static void print_backward(uint32_t data, int width)
+{
+    if (width == 24) {
+        // Event message, same layout as DALIDriver::parse_event
+        printf("EVENT A%lu type %lu info 0x%03lX",
+               (unsigned long)(data >> 17),
+               (unsigned long)((data >> 10) & 0x7F),
+               (unsigned long)(data & 0x03FF));
+    } else if (data == 0xFF) {
+        printf("YES");
+    } else {
+        printf("ANSWER 0x%02lX (%lu)", (unsigned long)data,
+               (unsigned long)data);
+    }
+}
+
+static const char *status_name(TraceStatus status)
+{
+    switch (status) {
+        case TRACE_NO_ANSWER:
+            return "NO ANSWER";
+        case TRACE_FRAMING_ERROR:
+            return "FRAMING ERROR";
+        case TRACE_COLLISION:
+            return "COLLISION";
+        default:
+            return "";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    if (argc > 1) {
+        in = fopen(argv[1], "rb");
+        if (!in) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+    uint8_t buf[TRACE_HEADER_SIZE];
+    if (fread(buf, 1, TRACE_HEADER_SIZE, in) != TRACE_HEADER_SIZE ||
+        memcmp(buf, TRACE_MAGIC, 4) != 0) {
+        fprintf(stderr, "not a DALI trace dump\n");
+        return 1;
+    }
+    if (buf[4] != TRACE_VERSION) {
+        fprintf(stderr, "unsupported trace version %d\n", buf[4]);
+        return 1;
+    }
+    uint32_t count = trace_get_u32(&buf[8]);
+    printf("# half bit %d us, %lu records, %lu overwritten\n",
+           buf[6] | (buf[7] << 8), (unsigned long)count,
+           (unsigned long)trace_get_u32(&buf[12]));
+    printf("#    time_us    gap_us dir bits  data    command\n");
+
+    uint32_t prev = 0;
+    int device_type = -1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (fread(buf, 1, TRACE_RECORD_SIZE, in) != TRACE_RECORD_SIZE) {
+            fprintf(stderr, "dump truncated at record %lu\n",
+                    (unsigned long)i);
+            return 1;
+        }
+        trace_record r;
+        r.timestamp_us = trace_get_u32(&buf[0]);
+        r.frame = trace_get_u32(&buf[4]);
+        uint32_t data = trace_data(r);
+        int width = trace_width(r);
+        TraceDirection dir = trace_direction(r);
+        TraceStatus status = trace_status(r);
+
+        printf("%12lu %9lu %s %4d  %06lX  ", (unsigned long)r.timestamp_us,
+               i ? (unsigned long)(r.timestamp_us - prev) : 0UL,
+               dir == TRACE_FORWARD ? "-> " : "<- ", width,
+               (unsigned long)data);
+        prev = r.timestamp_us;
+
+        if (status == TRACE_NO_ANSWER) {
+            printf("%s\n", status_name(status));
+            continue;
+        }
+        int enabled = -1;
+        if (dir == TRACE_BACKWARD) {
+            print_backward(data, width);
+        } else if (width == 16) {
+            enabled = print_forward_16(data, device_type);
+        } else if (width == 24) {
+            print_forward_24(data);
+        }
+        // ENABLE_DEVICE_TYPE applies to the next forward frame only
+        if (dir == TRACE_FORWARD) {
+            device_type = enabled;
+        }
+        if (status != TRACE_OK) {
+            printf(" [%s]", status_name(status));
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,307 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HOST_MBED_H
+#define HOST_MBED_H
+
+// Host stand-ins for the parts of mbed the encoder and driver use, so the
+// unchanged sources run in tools/manchester_bench.cpp and
+// tools/replay_check.cpp
+//
+// Time is simulated: host_clock_us() only moves when host_run_until() runs the
+// Timeouts that are due or the benchmark drives the input pin with
+// InterruptIn::host_set()
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef int PinName;
+enum PinMode { PullNone, PullUp, PullDown };
+#define NC (-1)
+
+inline uint32_t &host_clock_us()
+{
+    static uint32_t now = 0;
+    return now;
+}
+
+inline void core_util_critical_section_enter()
+{
+}
+
+inline void core_util_critical_section_exit()
+{
+}
+
+inline void wait_us(int us)
+{
+    host_clock_us() += us;
+}
+
+inline void wait_ms(int ms)
+{
+    host_clock_us() += ms * 1000;
+}
+
+namespace mbed {
+
+template <typename F>
+class Callback;
+
+// Bound member function or plain function, copied by value like mbed's
+template <typename R, typename... A>
+class Callback<R(A...)> {
+public:
+    Callback(R (*func)(A...) = 0)
+    {
+        memset(&_func, 0, sizeof(_func));
+        _obj = 0;
+        _thunk = func ? &function_thunk : 0;
+        _func.func = func;
+    }
+
+    template <typename T>
+    Callback(T *obj, R (T::*method)(A...))
+    {
+        static_assert(sizeof(method) <= sizeof(_func), "method too large");
+        memset(&_func, 0, sizeof(_func));
+        memcpy(&_func, &method, sizeof(method));
+        _obj = obj;
+        _thunk = &method_thunk<T>;
+    }
+
+    R operator()(A... args) const
+    {
+        return _thunk(this, args...);
+    }
+
+    explicit operator bool() const
+    {
+        return _thunk != 0;
+    }
+
+private:
+    class Undefined;
+
+    static R function_thunk(const Callback *cb, A... args)
+    {
+        return cb->_func.func(args...);
+    }
+
+    template <typename T>
+    static R method_thunk(const Callback *cb, A... args)
+    {
+        R (T::*method)(A...);
+        memcpy(&method, &cb->_func, sizeof(method));
+        return (((T *)cb->_obj)->*method)(args...);
+    }
+
+    union {
+        R (*func)(A...);
+        void (Undefined::*method)();
+    } _func;
+    void *_obj;
+    R (*_thunk)(const Callback *, A...);
+};
+
+template <typename R, typename... A>
+Callback<R(A...)> callback(R (*func)(A...))
+{
+    return Callback<R(A...)>(func);
+}
+
+template <typename T, typename R, typename... A>
+Callback<R(A...)> callback(T *obj, R (T::*method)(A...))
+{
+    return Callback<R(A...)>(obj, method);
+}
+
+class DigitalOut {
+public:
+    DigitalOut(PinName) : _value(0)
+    {
+    }
+
+    DigitalOut &operator=(int value)
+    {
+        _value = value;
+        return *this;
+    }
+
+private:
+    int _value;
+};
+
+class InterruptIn {
+public:
+    InterruptIn(PinName, PinMode = PullNone) : _level(0)
+    {
+        instance() = this;
+    }
+
+    void rise(Callback<void()> func)
+    {
+        _rise = func;
+    }
+
+    void fall(Callback<void()> func)
+    {
+        _fall = func;
+    }
+
+    int read()
+    {
+        return _level;
+    }
+
+    // Last pin constructed, the benchmark drives it
+    static InterruptIn *&instance()
+    {
+        static InterruptIn *pin = 0;
+        return pin;
+    }
+
+    // Change the level at the current time and run the attached handler
+    void host_set(int level)
+    {
+        if (level == _level) {
+            return;
+        }
+        _level = level;
+        Callback<void()> &handler = level ? _rise : _fall;
+        if (handler) {
+            handler();
+        }
+    }
+
+private:
+    int _level;
+    Callback<void()> _rise;
+    Callback<void()> _fall;
+};
+
+class Timeout {
+public:
+    Timeout() : _armed(false)
+    {
+        _next = list();
+        list() = this;
+    }
+
+    ~Timeout()
+    {
+        Timeout **t = &list();
+        while (*t != this) {
+            t = &(*t)->_next;
+        }
+        *t = _next;
+    }
+
+    void attach_us(Callback<void()> func, uint32_t us)
+    {
+        _func = func;
+        _due = host_clock_us() + us;
+        _armed = true;
+    }
+
+    void detach()
+    {
+        _armed = false;
+    }
+
+    // Run the Timeouts due before end in time order, then advance the clock
+    // to end
+    static void host_run_until(uint32_t end)
+    {
+        while (true) {
+            Timeout *first = 0;
+            for (Timeout *t = list(); t; t = t->_next) {
+                if (t->_armed && (int32_t)(t->_due - end) <= 0 &&
+                    (!first || (int32_t)(t->_due - first->_due) < 0)) {
+                    first = t;
+                }
+            }
+            if (!first) {
+                break;
+            }
+            host_clock_us() = first->_due;
+            first->_armed = false;
+            first->_func();
+        }
+        host_clock_us() = end;
+    }
+
+private:
+    static Timeout *&list()
+    {
+        static Timeout *head = 0;
+        return head;
+    }
+
+    Callback<void()> _func;
+    uint32_t _due;
+    bool _armed;
+    Timeout *_next;
+};
+
+class Timer {
+public:
+    Timer() : _start(0)
+    {
+    }
+
+    void start()
+    {
+        _start = host_clock_us();
+    }
+
+    void stop()
+    {
+    }
+
+    int read_us()
+    {
+        return host_clock_us() - _start;
+    }
+
+    uint64_t read_high_resolution_us()
+    {
+        return host_clock_us() - _start;
+    }
+
+private:
+    uint32_t _start;
+};
+
+class EventFlags {
+public:
+    uint32_t set(uint32_t flags)
+    {
+        return flags;
+    }
+
+    uint32_t wait_all(uint32_t flags, uint32_t = 0)
+    {
+        return flags;
+    }
+};
+
+} // namespace mbed
+
+using namespace mbed;
+
+#endif
@@ -0,0 +1,196 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host microbenchmark of the encoder receive interrupt handlers, fed with
+// synthetic edge streams through the stand-ins in host/mbed.h. The time
+// measured includes the stand-in InterruptIn and Timeout dispatch.
+//
+// Build: c++ -O2 -Ihost -o manchester_bench manchester_bench.cpp
+//        ../manchester/encoder.cpp
+// Usage: manchester_bench [frames per stream]
+
+#include "../manchester/encoder.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// 1200 baud
+#define HALF_BIT_US 416
+// Idle time between frames
+#define FRAME_GAP_US 10000
+
+enum StreamType { STREAM_CLEAN, STREAM_JITTER, STREAM_NOISE };
+
+struct bench_edge {
+    bool level;
+    uint32_t timestamp_us;
+};
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng()
+{
+    // xorshift32, the same streams on every run
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Random offset in [-max_us, max_us]
+static int32_t jitter(uint32_t max_us)
+{
+    return (int32_t)(rng() % (2 * max_us + 1)) - (int32_t)max_us;
+}
+
+// Append the edges of a frame starting at t, returns the end of the frame
+static uint32_t add_frame(std::vector<bench_edge> &edges, uint32_t data,
+                          int bits, uint32_t t, StreamType type)
+{
+    // Line level for every half bit: start bit, data bits, MSB first
+    bool halves[2 * 25];
+    int n = 0;
+    halves[n++] = 1;
+    halves[n++] = 0;
+    for (int i = bits - 1; i >= 0; i--) {
+        bool bit = (data >> i) & 1;
+        halves[n++] = bit;
+        halves[n++] = !bit;
+    }
+    bool level = 0;
+    for (int i = 0; i < n; i++) {
+        uint32_t at = t + i * HALF_BIT_US;
+        if (halves[i] != level) {
+            level = halves[i];
+            // DALI allows +-10% on the half bit time
+            int32_t offset = 0;
+            if (type != STREAM_CLEAN) {
+                offset = jitter(HALF_BIT_US / 10);
+            }
+            bench_edge e = {level, at + offset};
+            edges.push_back(e);
+        }
+        if (type == STREAM_NOISE && rng() % 8 == 0) {
+            // 20 us spike in the middle of a half bit
+            uint32_t spike = at + HALF_BIT_US / 2 - 10;
+            bench_edge up = {(bool)!level, spike};
+            bench_edge down = {level, spike + 20};
+            edges.push_back(up);
+            edges.push_back(down);
+        }
+    }
+    if (level) {
+        // Back to idle after the last bit
+        bench_edge e = {0, t + n * HALF_BIT_US};
+        edges.push_back(e);
+    }
+    return t + n * HALF_BIT_US;
+}
+
+struct bench_result {
+    size_t edges;
+    int frames;
+    int decoded;
+    encoder_stats stats;
+    double ns_per_edge;
+    double ns_per_frame;
+};
+
+// Frame being fed to the encoder and whether it was received intact
+static uint32_t expected;
+static bool matched;
+
+static void frame_received(uint32_t data)
+{
+    if (data == expected) {
+        matched = true;
+    }
+}
+
+static bench_result run(StreamType type, int bits, int frames)
+{
+    std::vector<bench_edge> edges;
+    std::vector<uint32_t> sent;
+    std::vector<uint32_t> starts;
+    uint32_t t = 1000;
+    uint32_t mask = (1UL << bits) - 1;
+    for (int i = 0; i < frames; i++) {
+        uint32_t data = rng() & mask;
+        sent.push_back(data);
+        // Noise spikes and jitter stay within the first half bit
+        starts.push_back(t - HALF_BIT_US / 2);
+        t = add_frame(edges, data, bits, t, type) + FRAME_GAP_US;
+    }
+
+    host_clock_us() = 0;
+    // 1200 baud, the half bit time of the encoder matches HALF_BIT_US
+    ManchesterEncoder encoder(0, 1, 1200);
+    InterruptIn *pin = InterruptIn::instance();
+    encoder.attach(callback(frame_received));
+    encoder.set_recv_frame_length(bits);
+    encoder.reset_stats();
+    bench_result result = {edges.size(), frames, 0, encoder_stats(), 0, 0};
+    matched = false;
+    size_t frame = 0;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (frame < starts.size() && edges[i].timestamp_us >= starts[frame]) {
+            // The last frame has been stopped by now, see FRAME_GAP_US
+            Timeout::host_run_until(starts[frame]);
+            result.decoded += matched;
+            expected = sent[frame++];
+            matched = false;
+        }
+        Timeout::host_run_until(edges[i].timestamp_us);
+        pin->host_set(edges[i].level);
+    }
+    Timeout::host_run_until(t);
+    result.decoded += matched;
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    result.ns_per_edge = ns / result.edges;
+    result.ns_per_frame = ns / frames;
+    encoder.get_stats(result.stats);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 100000;
+    if (frames <= 0) {
+        fprintf(stderr, "usage: manchester_bench [frames per stream]\n");
+        return 1;
+    }
+    static const char *names[] = {"clean", "jittered", "noisy"};
+    static const int widths[] = {8, 24};
+    printf("%-9s %4s %9s %9s %10s %8s %8s %9s\n", "stream", "bits", "edges",
+           "decoded", "collisions", "framing", "ns/edge", "ns/frame");
+    for (int type = STREAM_CLEAN; type <= STREAM_NOISE; type++) {
+        for (int w = 0; w < 2; w++) {
+            bench_result r = run((StreamType)type, widths[w], frames);
+            printf("%-9s %4d %9lu %8.1f%% %10lu %8lu %8.1f %9.1f\n",
+                   names[type], widths[w], (unsigned long)r.edges,
+                   100.0 * r.decoded / r.frames,
+                   (unsigned long)r.stats.collisions,
+                   (unsigned long)r.stats.framing_errors, r.ns_per_edge,
+                   r.ns_per_frame);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host regression check of the frame cost of the driver calls, replaying the
+// recordings in replay_fixtures.h through the stand-ins in host/mbed.h. Fails
+// when a call sends more frames than its budget or anything else than what
+// was recorded.
+//
+// Build: c++ -I.. -I../manchester -Ihost -o replay_check replay_check.cpp
+//        ../DALIDriver.cpp ../DALIReplay.cpp ../DALISimBus.cpp
+//        ../DALIColor.cpp ../DALISceneCache.cpp ../DALIIdentityMap.cpp
+//        ../manchester/encoder.cpp
+// Usage: replay_check               check against the recordings
+//        replay_check --record      print new recordings from DALISimBus,
+//                                   redirect to replay_fixtures.h
+
+#include "../DALIDriver.h"
+#include "../DALIReplay.h"
+#include "../DALISimBus.h"
+#include "replay_fixtures.h"
+#include <stdio.h>
+#include <string.h>
+
+// Bus the recordings are made on
+#define REC_GEAR 4
+#define REC_INPUTS 1
+#define REC_INSTANCES 2
+#define REC_SEED 1
+
+#define MAX_RECORDS 4096
+
+struct replay_step {
+    const char *name;
+    DALIApi api;
+    void (*run)(DALIDriver &dali);
+    const replay_frame *frames;
+    int num_frames;
+    uint32_t budget;
+};
+
+static void run_init(DALIDriver &dali)
+{
+    dali.init();
+}
+
+static void run_set_color_scene(DALIDriver &dali)
+{
+    dali.set_color_scene(0, 3, 254, 128, 0);
+}
+
+static void run_go_to_scene(DALIDriver &dali)
+{
+    dali.go_to_scene(dali.get_group_addr(1), 3);
+}
+
+// Run in order, each call starts from the driver state the previous left
+static const replay_step steps[] = {
+    {"init", API_INIT, run_init, init_rec,
+     sizeof(init_rec) / sizeof(init_rec[0]), INIT_BUDGET},
+    {"set_color_scene", API_SET_COLOR_SCENE, run_set_color_scene,
+     set_color_scene_rec,
+     sizeof(set_color_scene_rec) / sizeof(set_color_scene_rec[0]),
+     SET_COLOR_SCENE_BUDGET},
+    {"go_to_scene", API_GO_TO_SCENE, run_go_to_scene, go_to_scene_rec,
+     sizeof(go_to_scene_rec) / sizeof(go_to_scene_rec[0]),
+     GO_TO_SCENE_BUDGET},
+};
+#define NUM_STEPS (int)(sizeof(steps) / sizeof(steps[0]))
+
+static trace_record trace_buf[MAX_RECORDS];
+static trace_record records[MAX_RECORDS];
+static int num_records;
+static replay_frame frames[MAX_RECORDS];
+// Too large for the stack
+static dali_stats stats;
+
+// Collect a trace dump back into records, the header is skipped
+static void collect(const uint8_t *data, size_t size)
+{
+    if (size != TRACE_RECORD_SIZE) {
+        num_records = 0;
+        return;
+    }
+    records[num_records].timestamp_us = trace_get_u32(&data[0]);
+    records[num_records].frame = trace_get_u32(&data[4]);
+    num_records++;
+}
+
+static void upper(const char *name, char *out)
+{
+    for (; *name; name++, out++) {
+        *out = *name >= 'a' && *name <= 'z' ? *name - 'a' + 'A' : *name;
+    }
+    *out = 0;
+}
+
+static int record(DALIDriver &dali)
+{
+    static DALISimBus sim;
+    sim.reset(REC_GEAR, REC_INPUTS, REC_INSTANCES, SIM_RANDOM_UNIFORM,
+              REC_SEED);
+    dali.encoder.set_bus_model(&sim);
+
+    printf("/* DALI Driver\n"
+           " * Copyright (c) 2018 ARM Limited\n"
+           " *\n"
+           " * Licensed under the Apache License, Version 2.0 (the "
+           "\"License\");\n"
+           " * you may not use this file except in compliance with the "
+           "License.\n"
+           " * You may obtain a copy of the License at\n"
+           " *\n"
+           " *     http://www.apache.org/licenses/LICENSE-2.0\n"
+           " *\n"
+           " * Unless required by applicable law or agreed to in writing, "
+           "software\n"
+           " * distributed under the License is distributed on an \"AS IS\" "
+           "BASIS,\n"
+           " * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or "
+           "implied.\n"
+           " * See the License for the specific language governing "
+           "permissions and\n"
+           " * limitations under the License.\n"
+           " */\n"
+           "\n"
+           "#ifndef REPLAY_FIXTURES_H\n"
+           "#define REPLAY_FIXTURES_H\n"
+           "\n"
+           "// Recorded by replay_check --record on a DALISimBus with %d "
+           "control gear and\n"
+           "// %d input device with %d instances, uniform random addresses, "
+           "seed %d.\n"
+           "// The budgets are the frames each call sent when recorded, "
+           "lower them when a\n"
+           "// change makes a call cheaper.\n"
+           "\n"
+           "#include \"../DALIReplay.h\"\n",
+           REC_GEAR, REC_INPUTS, REC_INSTANCES, REC_SEED);
+
+    for (int i = 0; i < NUM_STEPS; i++) {
+        const replay_step &step = steps[i];
+        dali.encoder.enable_trace(trace_buf, MAX_RECORDS);
+        dali.reset_stats();
+        step.run(dali);
+        dali.get_stats(stats);
+        num_records = 0;
+        dali.encoder.dump_trace(callback(collect));
+        dali.encoder.disable_trace();
+        if (num_records == MAX_RECORDS) {
+            fprintf(stderr, "%s: trace buffer full\n", step.name);
+            return 1;
+        }
+        int n = DALIReplay::from_trace(records, num_records, frames,
+                                       MAX_RECORDS);
+
+        char name[32];
+        upper(step.name, name);
+        printf("\nstatic const replay_frame %s_rec[] = {", step.name);
+        for (int f = 0; f < n; f++) {
+            printf(f % 4 ? " " : "\n    ");
+            printf("{0x%04lX, %d, %d},", (unsigned long)frames[f].forward,
+                   frames[f].bits, frames[f].backward);
+        }
+        printf("\n};\n#define %s_BUDGET %lu\n", name,
+               (unsigned long)stats.api[step.api].frames);
+    }
+    printf("\n#endif\n");
+    dali.encoder.set_bus_model(NULL);
+    return 0;
+}
+
+static int check(DALIDriver &dali)
+{
+    int failed = 0;
+    for (int i = 0; i < NUM_STEPS; i++) {
+        const replay_step &step = steps[i];
+        DALIReplay replay(step.frames, step.num_frames);
+        dali.encoder.set_bus_model(&replay);
+        dali.reset_stats();
+        step.run(dali);
+        dali.get_stats(stats);
+        dali.encoder.set_bus_model(NULL);
+
+        replay_report report;
+        replay.get_report(report);
+        uint32_t sent = stats.api[step.api].frames;
+        printf("%-16s %5lu frames, budget %5lu, %8.3f s bus time",
+               step.name, (unsigned long)sent, (unsigned long)step.budget,
+               stats.api[step.api].total_us / 1e6);
+        if (sent > step.budget) {
+            printf(" FAIL: over budget\n");
+            failed++;
+        } else if (!replay.matched()) {
+            printf(" FAIL: first differing frame %d, %lu missing, %lu "
+                   "extra\n",
+                   report.first_mismatch, (unsigned long)report.missing,
+                   (unsigned long)report.extra);
+            failed++;
+        } else {
+            printf(" ok\n");
+        }
+        if (!replay.matched()) {
+            // The driver state no longer follows the recordings
+            break;
+        }
+    }
+    if (failed) {
+        printf("If the change is intended, re-record with --record\n");
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    static DALIDriver dali(0, 1);
+    if (argc > 1 && strcmp(argv[1], "--record") == 0) {
+        return record(dali);
+    }
+    return check(dali);
+}
@@ -0,0 +1,300 @@
+/* DALI Driver
+ * Copyright (c) 2018 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REPLAY_FIXTURES_H
+#define REPLAY_FIXTURES_H
+
+// Recorded by replay_check --record on a DALISimBus with 4 control gear and
+// 1 input device with 2 instances, uniform random addresses, seed 1.
+// The budgets are the frames each call sent when recorded, lower them when a
+// change makes a call cheaper.
+
+#include "../DALIReplay.h"
+
+static const replay_frame init_rec[] = {
+    {0xFFFE1D, 24, -1}, {0xA500, 16, -1}, {0xA500, 16, -1}, {0xA700, 16, -1},
+    {0xA700, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB17F, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1BF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB19F, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB18F, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB183, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB185, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB186, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB187, 16, -1}, {0xB37F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB33F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB187, 16, -1}, {0xB35F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB187, 16, -1}, {0xB36F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB187, 16, -1}, {0xB377, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB373, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB370, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB57F, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB53F, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB51F, 16, -1},
+    {0xA900, 16, -1}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB52F, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB527, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB523, 16, -1},
+    {0xA900, 16, -1}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB525, 16, -1},
+    {0xA900, 16, 255}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB524, 16, -1},
+    {0xA900, 16, -1}, {0xB187, 16, -1}, {0xB371, 16, -1}, {0xB525, 16, -1},
+    {0xA900, 16, 255}, {0xBB00, 16, 255}, {0xAB00, 16, -1}, {0xA500, 16, -1},
+    {0xA500, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB17F, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1BF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB19F, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1AF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1B7, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1B3, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1B1, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1B2, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB37F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB33F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB31F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1B2, 16, -1}, {0xB32F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1B2, 16, -1}, {0xB337, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB331, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1B2, 16, -1}, {0xB332, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB57F, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB53F, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB51F, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB50F, 16, -1},
+    {0xA900, 16, -1}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB517, 16, -1},
+    {0xA900, 16, -1}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB51B, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB519, 16, -1},
+    {0xA900, 16, -1}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB51A, 16, -1},
+    {0xA900, 16, 255}, {0xB1B2, 16, -1}, {0xB333, 16, -1}, {0xB51A, 16, -1},
+    {0xA900, 16, 255}, {0xBB00, 16, 255}, {0xAB00, 16, -1}, {0xA500, 16, -1},
+    {0xA500, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB17F, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1BF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1DF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1CF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1D7, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D3, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D1, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB37F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB33F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB31F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1D0, 16, -1}, {0xB32F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB327, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB321, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1D0, 16, -1}, {0xB322, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB57F, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB53F, 16, -1},
+    {0xA900, 16, -1}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB55F, 16, -1},
+    {0xA900, 16, -1}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB56F, 16, -1},
+    {0xA900, 16, -1}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB577, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB573, 16, -1},
+    {0xA900, 16, -1}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB575, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB574, 16, -1},
+    {0xA900, 16, 255}, {0xB1D0, 16, -1}, {0xB323, 16, -1}, {0xB574, 16, -1},
+    {0xA900, 16, 255}, {0xBB00, 16, 255}, {0xAB00, 16, -1}, {0xA500, 16, -1},
+    {0xA500, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB17F, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1BF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1DF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1EF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1F7, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1FB, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1F8, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1F9, 16, -1}, {0xB37F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB33F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB31F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB30F, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1F9, 16, -1}, {0xB317, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1F9, 16, -1}, {0xB31B, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xB1F9, 16, -1}, {0xB31D, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB57F, 16, -1},
+    {0xA900, 16, -1}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB5BF, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB59F, 16, -1},
+    {0xA900, 16, -1}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB5AF, 16, -1},
+    {0xA900, 16, -1}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB5B7, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB5B3, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB5B1, 16, -1},
+    {0xA900, 16, -1}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB5B2, 16, -1},
+    {0xA900, 16, 255}, {0xB1F9, 16, -1}, {0xB31C, 16, -1}, {0xB5B2, 16, -1},
+    {0xA900, 16, 255}, {0xBB00, 16, 255}, {0xAB00, 16, -1}, {0xA500, 16, -1},
+    {0xA500, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1}, {0xB5FF, 16, -1},
+    {0xA900, 16, -1}, {0xA100, 16, -1}, {0xA5FF, 16, -1}, {0xA5FF, 16, -1},
+    {0xA700, 16, -1}, {0xA700, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB17F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB13F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB11F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB10F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB117, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB111, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB112, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB113, 16, -1}, {0xB37F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB113, 16, -1}, {0xB3BF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB113, 16, -1}, {0xB3DF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3CF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB113, 16, -1}, {0xB3D7, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3D9, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB113, 16, -1}, {0xB3DA, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB57F, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB53F, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB51F, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB50F, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB507, 16, -1}, {0xA900, 16, -1}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB50B, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB509, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB508, 16, -1}, {0xA900, 16, 255}, {0xB113, 16, -1}, {0xB3DB, 16, -1},
+    {0xB508, 16, -1}, {0xA900, 16, 255}, {0xB701, 16, -1}, {0xAB00, 16, -1},
+    {0xA5FF, 16, -1}, {0xA5FF, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB17F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB13F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB11F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB12F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB127, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB123, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB120, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB121, 16, -1}, {0xB37F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB121, 16, -1}, {0xB3BF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB39F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB38F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB121, 16, -1}, {0xB397, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB121, 16, -1}, {0xB39B, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB398, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB57F, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB53F, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB51F, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB50F, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB507, 16, -1}, {0xA900, 16, -1}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB50B, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB509, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB508, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB399, 16, -1},
+    {0xB508, 16, -1}, {0xA900, 16, 255}, {0xB703, 16, -1}, {0xAB00, 16, -1},
+    {0xA5FF, 16, -1}, {0xA5FF, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB17F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB13F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB11F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB12F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB127, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB123, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB121, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB122, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB37F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB33F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB31F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB122, 16, -1}, {0xB32F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB122, 16, -1}, {0xB337, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB331, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB122, 16, -1}, {0xB332, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB57F, 16, -1}, {0xA900, 16, -1}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB5BF, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB59F, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB58F, 16, -1}, {0xA900, 16, -1}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB597, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB593, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB591, 16, -1}, {0xA900, 16, 255}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB590, 16, -1}, {0xA900, 16, -1}, {0xB122, 16, -1}, {0xB333, 16, -1},
+    {0xB591, 16, -1}, {0xA900, 16, 255}, {0xB705, 16, -1}, {0xAB00, 16, -1},
+    {0xA5FF, 16, -1}, {0xA5FF, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB17F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB13F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB15F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB14F, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB153, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB155, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB156, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB37F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB33F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB31F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB30F, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB317, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB31B, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB31D, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB57F, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB53F, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB51F, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB50F, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB517, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB51B, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB519, 16, -1}, {0xA900, 16, 255}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB518, 16, -1}, {0xA900, 16, -1}, {0xB157, 16, -1}, {0xB31E, 16, -1},
+    {0xB519, 16, -1}, {0xA900, 16, 255}, {0xB707, 16, -1}, {0xAB00, 16, -1},
+    {0xA5FF, 16, -1}, {0xA5FF, 16, -1}, {0xB1FF, 16, -1}, {0xB3FF, 16, -1},
+    {0xB5FF, 16, -1}, {0xA900, 16, -1}, {0xA100, 16, -1}, {0xFFFE1D, 24, -1},
+    {0xA100, 16, -1}, {0xC13000, 24, -1}, {0xFFFE18, 24, -1}, {0xFFFE18, 24, -1},
+    {0xC130FF, 24, -1}, {0xFFFE14, 24, -1}, {0xFFFE14, 24, -1}, {0xC101FF, 24, -1},
+    {0xC101FF, 24, -1}, {0xC10200, 24, -1}, {0xC10200, 24, -1}, {0xC105FF, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC1057F, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, -1}, {0xC105BF, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC1059F, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, -1}, {0xC105AF, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, -1}, {0xC105B7, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC105B1, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, -1}, {0xC105B2, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, -1}, {0xC105B3, 24, -1},
+    {0xC1067F, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC1063F, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC1061F, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, -1}, {0xC105B3, 24, -1},
+    {0xC1062F, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC10627, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC10623, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC10621, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, -1}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC1077F, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC1073F, 24, -1}, {0xC10300, 24, -1}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC1075F, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC1074F, 24, -1}, {0xC10300, 24, 255}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC10747, 24, -1}, {0xC10300, 24, -1}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC1074B, 24, -1}, {0xC10300, 24, -1}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC1074D, 24, -1}, {0xC10300, 24, -1}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC1074E, 24, -1}, {0xC10300, 24, -1}, {0xC105B3, 24, -1},
+    {0xC10622, 24, -1}, {0xC1074F, 24, -1}, {0xC10300, 24, 255}, {0xC10804, 24, -1},
+    {0xC10400, 24, -1}, {0xC1017F, 24, -1}, {0xC1017F, 24, -1}, {0xC105FF, 24, -1},
+    {0xC106FF, 24, -1}, {0xC107FF, 24, -1}, {0xC10300, 24, -1}, {0xC10000, 24, -1},
+    {0xC13001, 24, -1}, {0xFFFF67, 24, -1}, {0xFFFF67, 24, -1}, {0x9FE35, 24, 2},
+    {0x90080, 24, 3}, {0x90062, 24, -1}, {0x90062, 24, -1}, {0xC1301C, 24, -1},
+    {0x90068, 24, -1}, {0x90068, 24, -1}, {0x90180, 24, 4}, {0x90163, 24, -1},
+    {0x90163, 24, -1},
+};
+#define INIT_BUDGET 1021
+
+static const replay_frame set_color_scene_rec[] = {
+    {0xA3FE, 16, -1}, {0xC380, 16, -1}, {0xC500, 16, -1}, {0xC108, 16, -1},
+    {0x01EB, 16, -1}, {0xA300, 16, -1}, {0xC3FF, 16, -1}, {0xC5FF, 16, -1},
+    {0xC108, 16, -1}, {0x01EC, 16, -1}, {0x01B3, 16, 255}, {0xA3FF, 16, -1},
+    {0x0143, 16, -1}, {0x0143, 16, -1},
+};
+#define SET_COLOR_SCENE_BUDGET 14
+
+static const replay_frame go_to_scene_rec[] = {
+    {0x8313, 16, -1}, {0x8313, 16, -1}, {0xC108, 16, -1}, {0x83E2, 16, -1},
+};
+#define GO_TO_SCENE_BUDGET 4
+
+#endif